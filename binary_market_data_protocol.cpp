@@ -0,0 +1,581 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ITCH-style fixed-layout messages. Every message starts with its total length and a type byte,
+// fields are little-endian and unpadded, and prices are integers in units of 1/10000. Decoders
+// accept messages longer than they know about, so fields can be appended in later versions.
+#pragma pack(push, 1)
+struct MessageHeader {
+    uint16_t length;
+    char type;
+    uint64_t timestampNs;
+};
+
+struct AddOrderMessage {
+    MessageHeader header;  // 'A'
+    uint64_t orderRef;
+    char side;             // 'B' or 'S'
+    uint32_t shares;
+    char stock[8];
+    int64_t price;
+};
+
+struct OrderExecutedMessage {
+    MessageHeader header;  // 'E'
+    uint64_t orderRef;
+    uint32_t executedShares;
+    uint64_t matchNumber;
+};
+
+struct OrderCancelMessage {
+    MessageHeader header;  // 'X'
+    uint64_t orderRef;
+    uint32_t cancelledShares;
+};
+
+struct OrderReplaceMessage {
+    MessageHeader header;  // 'U'
+    uint64_t originalOrderRef;
+    uint64_t newOrderRef;
+    uint32_t shares;
+    int64_t price;
+};
+
+struct TradeMessage {
+    MessageHeader header;  // 'P'
+    uint64_t orderRef;
+    char side;
+    uint32_t shares;
+    char stock[8];
+    int64_t price;
+    uint64_t matchNumber;
+};
+#pragma pack(pop)
+
+const int64_t PRICE_SCALE = 10000;
+const char CAPTURE_MAGIC[8] = {'I', 'T', 'C', 'H', 'C', 'A', 'P', '1'};
+
+// Walks a buffer of framed messages and hands each one to the handler as a typed reference into the
+// buffer itself; nothing is copied or allocated. The handler needs onAddOrder, onOrderExecuted,
+// onOrderCancel, onOrderReplace and onTrade overloads; unknown types are skipped by length.
+template <typename Handler>
+class MessageDecoder {
+public:
+    explicit MessageDecoder(Handler& handler) : handler(handler), malformed(0) {}
+
+    // Returns the number of bytes consumed; a trailing partial message is left for the caller.
+    size_t decode(const uint8_t* data, size_t size) {
+        size_t offset = 0;
+        while (size - offset >= sizeof(MessageHeader)) {
+            const MessageHeader* header = reinterpret_cast<const MessageHeader*>(data + offset);
+            if (header->length < sizeof(MessageHeader)) {
+                ++malformed;
+                return size;
+            }
+            if (header->length > size - offset) {
+                break;
+            }
+            dispatch(header);
+            offset += header->length;
+        }
+        return offset;
+    }
+
+    uint64_t malformedCount() const {
+        return malformed;
+    }
+
+private:
+    Handler& handler;
+    uint64_t malformed;
+
+    template <typename Message>
+    bool fits(const MessageHeader* header) {
+        if (header->length < sizeof(Message)) {
+            ++malformed;
+            return false;
+        }
+        return true;
+    }
+
+    void dispatch(const MessageHeader* header) {
+        switch (header->type) {
+        case 'A':
+            if (fits<AddOrderMessage>(header)) handler.onAddOrder(*reinterpret_cast<const AddOrderMessage*>(header));
+            break;
+        case 'E':
+            if (fits<OrderExecutedMessage>(header)) handler.onOrderExecuted(*reinterpret_cast<const OrderExecutedMessage*>(header));
+            break;
+        case 'X':
+            if (fits<OrderCancelMessage>(header)) handler.onOrderCancel(*reinterpret_cast<const OrderCancelMessage*>(header));
+            break;
+        case 'U':
+            if (fits<OrderReplaceMessage>(header)) handler.onOrderReplace(*reinterpret_cast<const OrderReplaceMessage*>(header));
+            break;
+        case 'P':
+            if (fits<TradeMessage>(header)) handler.onTrade(*reinterpret_cast<const TradeMessage*>(header));
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+// Read-only view of a capture file: an 8-byte magic followed by framed messages.
+class CaptureFile {
+public:
+    explicit CaptureFile(const std::string& path) : base(nullptr), length(0) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                base = static_cast<const uint8_t*>(mapped);
+                length = static_cast<size_t>(info.st_size);
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        base = reinterpret_cast<const uint8_t*>(fallback.data());
+        length = fallback.size();
+#endif
+    }
+
+    ~CaptureFile() {
+#ifndef _WIN32
+        if (base) {
+            munmap(const_cast<uint8_t*>(base), length);
+        }
+#endif
+    }
+
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+
+    bool valid() const {
+        return base && length >= sizeof(CAPTURE_MAGIC) && std::memcmp(base, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) == 0;
+    }
+
+    const uint8_t* messages() const { return base + sizeof(CAPTURE_MAGIC); }
+    size_t messageBytes() const { return length - sizeof(CAPTURE_MAGIC); }
+
+private:
+    const uint8_t* base;
+    size_t length;
+#ifdef _WIN32
+    std::vector<char> fallback;
+#endif
+};
+
+// Counts messages and keeps the live share count per order, the minimum a book builder would need.
+class FeedStatistics {
+public:
+    uint64_t adds = 0;
+    uint64_t executions = 0;
+    uint64_t cancels = 0;
+    uint64_t replaces = 0;
+    uint64_t trades = 0;
+    uint64_t unknownOrders = 0;
+    uint64_t executedShares = 0;
+    int64_t lastTimestampNs = 0;
+
+    FeedStatistics() {
+        liveShares.reserve(1 << 16);
+    }
+
+    void onAddOrder(const AddOrderMessage& message) {
+        ++adds;
+        liveShares[message.orderRef] = message.shares;
+        lastTimestampNs = message.header.timestampNs;
+    }
+
+    void onOrderExecuted(const OrderExecutedMessage& message) {
+        ++executions;
+        executedShares += message.executedShares;
+        reduce(message.orderRef, message.executedShares);
+        lastTimestampNs = message.header.timestampNs;
+    }
+
+    void onOrderCancel(const OrderCancelMessage& message) {
+        ++cancels;
+        reduce(message.orderRef, message.cancelledShares);
+        lastTimestampNs = message.header.timestampNs;
+    }
+
+    void onOrderReplace(const OrderReplaceMessage& message) {
+        ++replaces;
+        auto it = liveShares.find(message.originalOrderRef);
+        if (it == liveShares.end()) {
+            ++unknownOrders;
+        } else {
+            liveShares.erase(it);
+        }
+        liveShares[message.newOrderRef] = message.shares;
+        lastTimestampNs = message.header.timestampNs;
+    }
+
+    void onTrade(const TradeMessage& message) {
+        ++trades;
+        executedShares += message.shares;
+        lastTimestampNs = message.header.timestampNs;
+    }
+
+    uint64_t total() const {
+        return adds + executions + cancels + replaces + trades;
+    }
+
+    size_t liveOrders() const {
+        return liveShares.size();
+    }
+
+    void print(const std::string& label) const {
+        std::cout << label << ": " << total() << " messages (add " << adds << ", exec " << executions
+                  << ", cancel " << cancels << ", replace " << replaces << ", trade " << trades << "), "
+                  << executedShares << " shares executed, " << liveOrders() << " live orders, "
+                  << unknownOrders << " unknown refs" << std::endl;
+    }
+
+private:
+    std::unordered_map<uint64_t, uint32_t> liveShares;
+
+    void reduce(uint64_t orderRef, uint32_t shares) {
+        auto it = liveShares.find(orderRef);
+        if (it == liveShares.end()) {
+            ++unknownOrders;
+            return;
+        }
+        if (it->second <= shares) {
+            liveShares.erase(it);
+        } else {
+            it->second -= shares;
+        }
+    }
+};
+
+// Holds each message back until its recorded offset from the first message has elapsed on the
+// wall clock (divided by `speed`), then forwards it.
+template <typename Handler>
+class PacedHandler {
+public:
+    PacedHandler(Handler& inner, double speed) : inner(inner), speed(speed), firstTimestampNs(-1) {}
+
+    void onAddOrder(const AddOrderMessage& message) { wait(message.header); inner.onAddOrder(message); }
+    void onOrderExecuted(const OrderExecutedMessage& message) { wait(message.header); inner.onOrderExecuted(message); }
+    void onOrderCancel(const OrderCancelMessage& message) { wait(message.header); inner.onOrderCancel(message); }
+    void onOrderReplace(const OrderReplaceMessage& message) { wait(message.header); inner.onOrderReplace(message); }
+    void onTrade(const TradeMessage& message) { wait(message.header); inner.onTrade(message); }
+
+private:
+    Handler& inner;
+    double speed;
+    int64_t firstTimestampNs;
+    std::chrono::steady_clock::time_point start;
+
+    void wait(const MessageHeader& header) {
+        int64_t timestampNs = static_cast<int64_t>(header.timestampNs);
+        if (firstTimestampNs < 0) {
+            firstTimestampNs = timestampNs;
+            start = std::chrono::steady_clock::now();
+            return;
+        }
+        auto due = start + std::chrono::nanoseconds(static_cast<int64_t>((timestampNs - firstTimestampNs) / speed));
+        auto now = std::chrono::steady_clock::now();
+        if (due - now > std::chrono::microseconds(100)) {
+            std::this_thread::sleep_until(due - std::chrono::microseconds(50));
+        }
+        while (std::chrono::steady_clock::now() < due) {
+        }
+    }
+};
+
+// Builds a deterministic capture: orders are added, partially executed, cancelled or replaced, with
+// the occasional non-displayed trade, at Poisson-like spacing around `meanGapNs`.
+class CaptureWriter {
+public:
+    static uint64_t writeSynthetic(const std::string& path, uint64_t messageCount, uint64_t seed, uint64_t meanGapNs = 1000) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        const char* stocks[] = {"AAPL    ", "MSFT    ", "GOOG    ", "AMZN    "};
+
+        std::vector<std::pair<uint64_t, uint32_t>> live;  // order ref and remaining shares
+        std::vector<uint8_t> buffer;
+        buffer.reserve(1 << 20);
+        uint64_t state = seed ? seed : 1;
+        uint64_t timestampNs = 0;
+        uint64_t nextRef = 1;
+        uint64_t matchNumber = 1;
+
+        for (uint64_t i = 0; i < messageCount; ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            timestampNs += 1 + state % (2 * meanGapNs);
+            unsigned choice = static_cast<unsigned>((state >> 32) % 100);
+            size_t pick = live.empty() ? 0 : static_cast<size_t>((state >> 8) % live.size());
+            const char* stock = stocks[(state >> 40) % 4];
+            int64_t price = (100 * PRICE_SCALE) + static_cast<int64_t>((state >> 16) % 2000) - 1000;
+
+            uint32_t shares = static_cast<uint32_t>(100 + (state >> 24) % 900);
+
+            if (live.empty() || choice < 45) {
+                AddOrderMessage message{{sizeof(AddOrderMessage), 'A', timestampNs}, nextRef, (state & 1) ? 'B' : 'S',
+                                        shares, {}, price};
+                std::memcpy(message.stock, stock, sizeof(message.stock));
+                live.emplace_back(nextRef++, shares);
+                append(buffer, message);
+            } else if (choice < 65) {
+                uint32_t executed = std::min<uint32_t>(100, live[pick].second);
+                OrderExecutedMessage message{{sizeof(OrderExecutedMessage), 'E', timestampNs}, live[pick].first, executed, matchNumber++};
+                live[pick].second -= executed;
+                if (live[pick].second == 0) {
+                    live[pick] = live.back();
+                    live.pop_back();
+                }
+                append(buffer, message);
+            } else if (choice < 85) {
+                OrderCancelMessage message{{sizeof(OrderCancelMessage), 'X', timestampNs}, live[pick].first, live[pick].second};
+                live[pick] = live.back();
+                live.pop_back();
+                append(buffer, message);
+            } else if (choice < 95) {
+                OrderReplaceMessage message{{sizeof(OrderReplaceMessage), 'U', timestampNs}, live[pick].first, nextRef, shares, price};
+                live[pick] = std::make_pair(nextRef++, shares);
+                append(buffer, message);
+            } else {
+                TradeMessage message{{sizeof(TradeMessage), 'P', timestampNs}, 0, 'B', 100, {}, price, matchNumber++};
+                std::memcpy(message.stock, stock, sizeof(message.stock));
+                append(buffer, message);
+            }
+
+            if (buffer.size() > (1 << 20) - 64) {
+                out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+                buffer.clear();
+            }
+        }
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        return messageCount;
+    }
+
+private:
+    template <typename Message>
+    static void append(std::vector<uint8_t>& buffer, const Message& message) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&message);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(Message));
+    }
+};
+
+#ifndef _WIN32
+// Loopback UDP transport: the sender packs whole messages into datagrams of at most
+// `maxDatagram` bytes, and the receiver decodes each datagram in place in one reusable buffer.
+class UdpFeedSender {
+public:
+    explicit UdpFeedSender(uint16_t port) : socketFd(socket(AF_INET, SOCK_DGRAM, 0)) {
+        std::memset(&destination, 0, sizeof(destination));
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(port);
+        destination.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+
+    ~UdpFeedSender() {
+        close(socketFd);
+    }
+
+    // Sleeps for `burstPause` after every `burstSize` datagrams so a loopback receiver doing real
+    // work per message is not simply overrun; a zero pause sends as fast as the socket accepts.
+    uint64_t sendCapture(const CaptureFile& capture, size_t maxDatagram = 1400, size_t burstSize = 4,
+                         std::chrono::microseconds burstPause = std::chrono::microseconds(100)) {
+        const uint8_t* data = capture.messages();
+        size_t size = capture.messageBytes();
+        size_t offset = 0;
+        uint64_t datagrams = 0;
+        while (offset + sizeof(MessageHeader) <= size) {
+            size_t end = offset;
+            while (end + sizeof(MessageHeader) <= size) {
+                uint16_t length = reinterpret_cast<const MessageHeader*>(data + end)->length;
+                if (length < sizeof(MessageHeader) || end + length > size || end + length - offset > maxDatagram) {
+                    break;
+                }
+                end += length;
+            }
+            if (end == offset) {
+                break;
+            }
+            sendto(socketFd, data + offset, end - offset, 0, reinterpret_cast<const sockaddr*>(&destination), sizeof(destination));
+            offset = end;
+            ++datagrams;
+            if (burstPause.count() > 0 && datagrams % burstSize == 0) {
+                std::this_thread::sleep_for(burstPause);
+            }
+        }
+        return datagrams;
+    }
+
+private:
+    int socketFd;
+    sockaddr_in destination;
+};
+
+class UdpFeedReceiver {
+public:
+    explicit UdpFeedReceiver(uint16_t port) : socketFd(socket(AF_INET, SOCK_DGRAM, 0)), buffer(65536) {
+        int receiveBuffer = 8 << 20;
+        setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+        timeval timeout{0, 200000};
+        setsockopt(socketFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bound = bind(socketFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    }
+
+    ~UdpFeedReceiver() {
+        close(socketFd);
+    }
+
+    bool ready() const {
+        return bound;
+    }
+
+    // Decodes datagrams until `stopFlag` is set and the socket has been idle for one timeout.
+    template <typename Handler>
+    uint64_t run(MessageDecoder<Handler>& decoder, const std::atomic<bool>& stopFlag) {
+        uint64_t datagrams = 0;
+        while (true) {
+            ssize_t received = recv(socketFd, buffer.data(), buffer.size(), 0);
+            if (received <= 0) {
+                if (stopFlag.load()) {
+                    return datagrams;
+                }
+                continue;
+            }
+            decoder.decode(buffer.data(), static_cast<size_t>(received));
+            ++datagrams;
+        }
+    }
+
+private:
+    int socketFd;
+    std::vector<uint8_t> buffer;
+    bool bound;
+};
+#endif
+
+class ReplayTool {
+public:
+    static bool replay(const std::string& path, bool paced, double speed) {
+        CaptureFile capture(path);
+        if (!capture.valid()) {
+            std::cout << "Not a capture file: " << path << std::endl;
+            return false;
+        }
+        FeedStatistics statistics;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t malformed;
+        if (paced) {
+            PacedHandler<FeedStatistics> pacing(statistics, speed);
+            MessageDecoder<PacedHandler<FeedStatistics>> decoder(pacing);
+            decoder.decode(capture.messages(), capture.messageBytes());
+            malformed = decoder.malformedCount();
+        } else {
+            MessageDecoder<FeedStatistics> decoder(statistics);
+            decoder.decode(capture.messages(), capture.messageBytes());
+            malformed = decoder.malformedCount();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        statistics.print(paced ? "Paced replay" : "Full-speed replay");
+        std::cout << "  " << seconds * 1000 << " ms, " << statistics.total() / seconds / 1e6 << " M msgs/s, "
+                  << capture.messageBytes() / seconds / 1e9 << " GB/s, " << malformed << " malformed" << std::endl;
+        return true;
+    }
+
+    static bool replayOverUdp(const std::string& path, uint16_t port) {
+#ifndef _WIN32
+        CaptureFile capture(path);
+        UdpFeedReceiver receiver(port);
+        if (!capture.valid() || !receiver.ready()) {
+            std::cout << "UDP replay needs a capture file and a free loopback port" << std::endl;
+            return false;
+        }
+        FeedStatistics statistics;
+        MessageDecoder<FeedStatistics> decoder(statistics);
+        std::atomic<bool> senderDone(false);
+        uint64_t received = 0;
+        std::thread receiving([&] { received = receiver.run(decoder, senderDone); });
+
+        UdpFeedSender sender(port);
+        uint64_t sent = sender.sendCapture(capture);
+        senderDone = true;
+        receiving.join();
+
+        statistics.print("UDP loopback replay");
+        std::cout << "  " << received << " of " << sent << " datagrams received" << std::endl;
+        return true;
+#else
+        (void)path;
+        (void)port;
+        std::cout << "UDP replay is not available on this platform" << std::endl;
+        return false;
+#endif
+    }
+};
+
+// Usage:
+//   binary_market_data_protocol generate <file> <messages> [seed]
+//   binary_market_data_protocol replay <file> [paced <speed>]
+//   binary_market_data_protocol udp <file> [port]
+// With no arguments it generates a small capture and runs all three replays on it.
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "demo";
+    if (mode == "generate" && argc > 3) {
+        uint64_t seed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+        uint64_t written = CaptureWriter::writeSynthetic(argv[2], std::strtoull(argv[3], nullptr, 10), seed);
+        std::cout << "Wrote " << written << " messages to " << argv[2] << std::endl;
+        return 0;
+    }
+    if (mode == "replay" && argc > 2) {
+        bool paced = argc > 3 && std::string(argv[3]) == "paced";
+        double speed = argc > 4 ? std::atof(argv[4]) : 1.0;
+        return ReplayTool::replay(argv[2], paced, speed > 0 ? speed : 1.0) ? 0 : 1;
+    }
+    if (mode == "udp" && argc > 2) {
+        uint16_t port = static_cast<uint16_t>(argc > 3 ? std::atoi(argv[3]) : 30001);
+        return ReplayTool::replayOverUdp(argv[2], port) ? 0 : 1;
+    }
+
+    const std::string path = "itch_capture.bin";
+    CaptureWriter::writeSynthetic(path, 2000000, 42);
+    ReplayTool::replay(path, false, 1.0);
+    ReplayTool::replay(path, true, 100.0);
+    ReplayTool::replayOverUdp(path, 30001);
+    return 0;
+}
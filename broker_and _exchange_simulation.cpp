@@ -1,10 +1,26 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <list>
 #include <algorithm>
 #include <queue>
 #include <string>
 #include <chrono>
+#include <unordered_map>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "order_book.h"
 
 class Order {
 public:
@@ -19,21 +35,124 @@ public:
     Type orderType;
     std::string userID;
     std::string timestamp;
+    long orderId;
 
-    Order(std::string s, double p, int q, Type t, std::string u, std::string ts)
-        : symbol(s), price(p), quantity(q), orderType(t), userID(u), timestamp(ts) {}
+    Order(std::string s, double p, int q, Type t, std::string u, std::string ts, long id = 0)
+        : symbol(s), price(p), quantity(q), orderType(t), userID(u), timestamp(ts), orderId(id) {}
+};
+
+struct TradeRecord {
+    uint64_t eventSequence;
+    int64_t buyOrderId;
+    int64_t sellOrderId;
+    double price;
+    int32_t quantity;
+    int32_t reserved;
+};
+
+class OrderIdIndex {
+public:
+    OrderIdIndex(size_t expectedEntries = 1024) : count(0) {
+        rehash(expectedEntries);
+    }
+
+    void insert(long orderId, int32_t value) {
+        if ((count + 1) * 2 > keys.size()) {
+            rehash(keys.size());
+        }
+        size_t slot = slotFor(orderId);
+        while (keys[slot] != 0 && keys[slot] != orderId) {
+            slot = (slot + 1) & mask;
+        }
+        if (keys[slot] == 0) {
+            ++count;
+        }
+        keys[slot] = orderId;
+        values[slot] = value;
+    }
+
+    int32_t find(long orderId) const {
+        size_t slot = slotFor(orderId);
+        while (keys[slot] != 0) {
+            if (keys[slot] == orderId) {
+                return values[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        return -1;
+    }
+
+    bool erase(long orderId) {
+        size_t slot = slotFor(orderId);
+        while (keys[slot] != orderId) {
+            if (keys[slot] == 0) {
+                return false;
+            }
+            slot = (slot + 1) & mask;
+        }
+        // Backward-shift deletion keeps probe chains intact without tombstones.
+        size_t hole = slot;
+        size_t next = (hole + 1) & mask;
+        while (keys[next] != 0) {
+            size_t home = slotFor(keys[next]);
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                keys[hole] = keys[next];
+                values[hole] = values[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        keys[hole] = 0;
+        --count;
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+private:
+    std::vector<long> keys;
+    std::vector<int32_t> values;
+    size_t mask;
+    size_t count;
+
+    size_t slotFor(long orderId) const {
+        return (static_cast<uint64_t>(orderId) * 0x9E3779B97F4A7C15ULL >> 20) & mask;
+    }
+
+    void rehash(size_t expectedEntries) {
+        size_t capacity = 16;
+        while (capacity < expectedEntries * 2) {
+            capacity <<= 1;
+        }
+        std::vector<long> oldKeys;
+        std::vector<int32_t> oldValues;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+        keys.assign(capacity, 0);
+        values.assign(capacity, -1);
+        mask = capacity - 1;
+        count = 0;
+        for (size_t i = 0; i < oldKeys.size(); ++i) {
+            if (oldKeys[i] != 0) {
+                insert(oldKeys[i], oldValues[i]);
+            }
+        }
+    }
 };
 
 class OrderBook {
 public:
-    std::map<double, std::queue<Order>> buyOrders;
-    std::map<double, std::queue<Order>> sellOrders;
+    std::map<double, std::list<Order>> buyOrders;
+    std::map<double, std::list<Order>> sellOrders;
+    std::vector<long> closedOrderIds;
+    std::vector<TradeRecord>* tradeSink = nullptr;
+    bool echoTrades = true;
 
     void addOrder(const Order& order) {
-        if (order.orderType == Order::Type::BUY) {
-            buyOrders[order.price].push(order);
-        } else {
-            sellOrders[order.price].push(order);
+        std::list<Order>& level = order.orderType == Order::Type::BUY ? buyOrders[order.price] : sellOrders[order.price];
+        level.push_back(order);
+        if (order.orderId != 0) {
+            orderIndex[order.orderId] = std::prev(level.end());
         }
     }
 
@@ -49,10 +168,16 @@ public:
                 sellIt->second.front().quantity -= matchQuantity;
 
                 if (buyIt->second.front().quantity == 0) {
-                    buyOrders.erase(buyIt->first);
+                    popFront(buyIt->second);
+                    if (buyIt->second.empty()) {
+                        buyOrders.erase(buyIt->first);
+                    }
                 }
                 if (sellIt->second.front().quantity == 0) {
-                    sellOrders.erase(sellIt->first);
+                    popFront(sellIt->second);
+                    if (sellIt->second.empty()) {
+                        sellOrders.erase(sellIt->first);
+                    }
                 }
             } else {
                 break;
@@ -61,10 +186,49 @@ public:
         return true;
     }
 
+    bool cancelOrder(long orderId) {
+        auto it = orderIndex.find(orderId);
+        if (it == orderIndex.end()) {
+            return false;
+        }
+        auto position = it->second;
+        orderIndex.erase(it);
+        removeFromLevel(position);
+        return true;
+    }
+
+    bool amendOrder(long orderId, int newQuantity, double newPrice) {
+        auto it = orderIndex.find(orderId);
+        if (it == orderIndex.end()) {
+            return false;
+        }
+        auto position = it->second;
+        if (newQuantity <= 0) {
+            orderIndex.erase(it);
+            removeFromLevel(position);
+            return true;
+        }
+        if (newPrice == position->price && newQuantity <= position->quantity) {
+            position->quantity = newQuantity;
+            return true;
+        }
+        Order amended = *position;
+        amended.price = newPrice;
+        amended.quantity = newQuantity;
+        removeFromLevel(position);
+        addOrder(amended);
+        return true;
+    }
+
     void executeTrade(const Order& buyOrder, const Order& sellOrder, int quantity) {
-        std::cout << "Trade Executed: " << quantity << " units of "
-                  << buyOrder.symbol << " at " << sellOrder.price << " price. "
-                  << "Buyer: " << buyOrder.userID << ", Seller: " << sellOrder.userID << std::endl;
+        if (tradeSink) {
+            tradeSink->push_back({0, buyOrder.orderId, sellOrder.orderId, sellOrder.price, quantity, 0});
+        }
+        if (echoTrades) {
+            std::cout << "Trade Executed: " << quantity << " units of "
+                      << buyOrder.symbol << " at " << sellOrder.price << " price. "
+                      << "Buyer: " << buyOrder.userID << ", Seller: " << sellOrder.userID << std::endl;
+        }
     }
 
     void printOrderBook() const {
@@ -79,55 +243,834 @@ public:
             std::cout << "Price: " << it->first << " Quantity: " << it->second.front().quantity << std::endl;
         }
     }
+
+    void forgetOrder(long orderId) {
+        if (orderIndex.erase(orderId)) {
+            closedOrderIds.push_back(orderId);
+        }
+    }
+
+private:
+    std::unordered_map<long, std::list<Order>::iterator> orderIndex;
+
+    void popFront(std::list<Order>& level) {
+        if (level.front().orderId != 0) {
+            orderIndex.erase(level.front().orderId);
+            closedOrderIds.push_back(level.front().orderId);
+        }
+        level.pop_front();
+    }
+
+    void removeFromLevel(std::list<Order>::iterator position) {
+        auto& side = position->orderType == Order::Type::BUY ? buyOrders : sellOrders;
+        auto level = side.find(position->price);
+        level->second.erase(position);
+        if (level->second.empty()) {
+            side.erase(level);
+        }
+    }
+};
+
+using matching::FifoAllocation;
+using matching::LevelBitmap;
+using matching::ProRataAllocation;
+using matching::TopOrderProRataAllocation;
+
+template <typename AllocationPolicy = FifoAllocation>
+class BasicPriceLadderBook {
+public:
+    std::vector<long> closedOrderIds;
+    std::vector<TradeRecord>* tradeSink = nullptr;
+    bool echoTrades = true;
+
+    BasicPriceLadderBook(const std::string& symbol, double tickSize, double midPrice, int levelCount, size_t maxOrders)
+        : symbol(symbol), tickSize(tickSize), bestBidIndex(-1), bestAskIndex(-1), freeHead(-1), lastLinked(-1), orderIndex(maxOrders) {
+        baseTick = toTicks(midPrice) - levelCount / 2;
+        bidLevels.resize(levelCount);
+        askLevels.resize(levelCount);
+        bidBitmap.resize(levelCount);
+        askBitmap.resize(levelCount);
+        nodes.resize(maxOrders);
+        for (size_t i = 0; i < maxOrders; ++i) {
+            nodes[i].next = (i + 1 < maxOrders) ? static_cast<int32_t>(i + 1) : -1;
+        }
+        freeHead = maxOrders > 0 ? 0 : -1;
+        closedOrderIds.reserve(maxOrders);
+    }
+
+    bool addOrder(const Order& order) {
+        int index = levelFor(order.price);
+        if (index < 0) {
+            return false;
+        }
+        if (freeHead < 0) {
+            std::cout << "Order rejected: " << symbol << " ladder is full" << std::endl;
+            return false;
+        }
+
+        int32_t nodeIndex = freeHead;
+        Node& node = nodes[nodeIndex];
+        freeHead = node.next;
+        node.quantity = order.quantity;
+        node.userIndex = internUser(order.userID);
+        node.orderId = order.orderId;
+        node.isBuy = order.orderType == Order::Type::BUY;
+        linkTail(nodeIndex, index);
+        if (order.orderId != 0) {
+            orderIndex.insert(order.orderId, nodeIndex);
+        }
+        return true;
+    }
+
+    bool matchOrders() {
+        if constexpr (AllocationPolicy::timePriorityOnly) {
+            matchHeads();
+        } else {
+            // Matching runs after every add, so a cross is the newest order opening a better level
+            // on its own. Anything else (several adds before one match) falls back to time priority.
+            int32_t aggressor = lastLinked;
+            lastLinked = -1;
+            while (bestBidIndex >= 0 && bestAskIndex >= 0 && bestBidIndex >= bestAskIndex) {
+                if (aggressor >= 0 && aggressor == bidLevels[bestBidIndex].head) {
+                    aggressor = allocateAgainst(aggressor, bestAskIndex);
+                } else if (aggressor >= 0 && aggressor == askLevels[bestAskIndex].head) {
+                    aggressor = allocateAgainst(aggressor, bestBidIndex);
+                } else {
+                    matchHeads();
+                    return true;
+                }
+            }
+        }
+        return true;
+    }
+
+    void matchHeads() {
+        while (bestBidIndex >= 0 && bestAskIndex >= 0 && bestBidIndex >= bestAskIndex) {
+            Level& bidLevel = bidLevels[bestBidIndex];
+            Level& askLevel = askLevels[bestAskIndex];
+            int32_t buyIndex = bidLevel.head;
+            int32_t sellIndex = askLevel.head;
+            Node& buyNode = nodes[buyIndex];
+            Node& sellNode = nodes[sellIndex];
+
+            int matchQuantity = std::min(buyNode.quantity, sellNode.quantity);
+            executeTrade(buyNode, sellNode, toPrice(bestAskIndex), matchQuantity);
+            buyNode.quantity -= matchQuantity;
+            sellNode.quantity -= matchQuantity;
+            bidLevel.totalQuantity -= matchQuantity;
+            askLevel.totalQuantity -= matchQuantity;
+
+            if (buyNode.quantity == 0) {
+                retireFilled(buyIndex);
+            }
+            if (sellNode.quantity == 0) {
+                retireFilled(sellIndex);
+            }
+        }
+    }
+
+    bool cancelOrder(long orderId) {
+        int32_t nodeIndex = orderIndex.find(orderId);
+        if (nodeIndex < 0) {
+            return false;
+        }
+        orderIndex.erase(orderId);
+        unlink(nodeIndex);
+        releaseNode(nodeIndex);
+        return true;
+    }
+
+    bool amendOrder(long orderId, int newQuantity, double newPrice) {
+        int32_t nodeIndex = orderIndex.find(orderId);
+        if (nodeIndex < 0) {
+            return false;
+        }
+        if (newQuantity <= 0) {
+            return cancelOrder(orderId);
+        }
+        int index = levelFor(newPrice);
+        if (index < 0) {
+            return false;
+        }
+        Node& node = nodes[nodeIndex];
+        if (index == node.levelIndex && newQuantity <= node.quantity) {
+            levelOf(node).totalQuantity -= node.quantity - newQuantity;
+            node.quantity = newQuantity;
+            return true;
+        }
+        unlink(nodeIndex);
+        node.quantity = newQuantity;
+        linkTail(nodeIndex, index);
+        return true;
+    }
+
+    bool cancelUserOrders(const std::string& userID) {
+        auto it = userIndex.find(userID);
+        if (it == userIndex.end()) {
+            return false;
+        }
+        bool orderFound = false;
+        for (int index = bestBidIndex; index >= 0; index = bidBitmap.highestAtOrBelow(index - 1)) {
+            orderFound |= removeUser(bidLevels[index], it->second);
+        }
+        for (int index = bestAskIndex; index >= 0; index = askBitmap.lowestAtOrAbove(index + 1)) {
+            orderFound |= removeUser(askLevels[index], it->second);
+        }
+        return orderFound;
+    }
+
+    bool hasBid() const { return bestBidIndex >= 0; }
+    bool hasAsk() const { return bestAskIndex >= 0; }
+    double bestBid() const { return toPrice(bestBidIndex); }
+    double bestAsk() const { return toPrice(bestAskIndex); }
+
+    void printOrderBook() const {
+        std::cout << "\nOrder Book (" << symbol << ", tick " << tickSize << "):\n";
+        std::cout << "Buy Orders:\n";
+        for (int index = bestBidIndex; index >= 0; index = bidBitmap.highestAtOrBelow(index - 1)) {
+            std::cout << "Price: " << toPrice(index) << " Quantity: " << bidLevels[index].totalQuantity << std::endl;
+        }
+
+        std::cout << "Sell Orders:\n";
+        for (int index = bestAskIndex; index >= 0; index = askBitmap.lowestAtOrAbove(index + 1)) {
+            std::cout << "Price: " << toPrice(index) << " Quantity: " << askLevels[index].totalQuantity << std::endl;
+        }
+    }
+
+private:
+    struct Node {
+        long orderId = 0;
+        int quantity = 0;
+        uint32_t userIndex = 0;
+        int32_t prev = -1;
+        int32_t next = -1;
+        int32_t levelIndex = -1;
+        bool isBuy = false;
+    };
+
+    struct Level {
+        int32_t head = -1;
+        int32_t tail = -1;
+        long totalQuantity = 0;
+    };
+
+    // What an allocation policy sees of the passive level it is filling an aggressor against.
+    class PassiveLevel {
+    public:
+        PassiveLevel(BasicPriceLadderBook& book, int32_t aggressor, int levelIndex)
+            : book(book), aggressor(aggressor), levelIndex(levelIndex),
+              level(book.nodes[aggressor].isBuy ? book.askLevels[levelIndex] : book.bidLevels[levelIndex]) {}
+
+        int32_t head() const { return level.head; }
+        bool valid(int32_t order) const { return order >= 0; }
+        int32_t next(int32_t order) const { return book.nodes[order].next; }
+        int quantity(int32_t order) const { return book.nodes[order].quantity; }
+        long totalQuantity() const { return level.totalQuantity; }
+
+        void fill(int32_t order, int quantity) {
+            if (quantity <= 0) {
+                return;
+            }
+            Node& taker = book.nodes[aggressor];
+            Node& maker = book.nodes[order];
+            book.executeTrade(taker.isBuy ? taker : maker, taker.isBuy ? maker : taker, book.toPrice(levelIndex), quantity);
+            taker.quantity -= quantity;
+            maker.quantity -= quantity;
+            book.levelOf(taker).totalQuantity -= quantity;
+            level.totalQuantity -= quantity;
+            if (maker.quantity == 0) {
+                book.retireFilled(order);
+            }
+        }
+
+    private:
+        BasicPriceLadderBook& book;
+        int32_t aggressor;
+        int levelIndex;
+        Level& level;
+    };
+
+    std::string symbol;
+    double tickSize;
+    int64_t baseTick;
+    std::vector<Level> bidLevels;
+    std::vector<Level> askLevels;
+    LevelBitmap bidBitmap;
+    LevelBitmap askBitmap;
+    int bestBidIndex;
+    int bestAskIndex;
+    std::vector<Node> nodes;
+    int32_t freeHead;
+    int32_t lastLinked;
+    OrderIdIndex orderIndex;
+    std::vector<std::string> users;
+    std::unordered_map<std::string, uint32_t> userIndex;
+
+    int64_t toTicks(double price) const {
+        return std::llround(price / tickSize);
+    }
+
+    double toPrice(int index) const {
+        return static_cast<double>(baseTick + index) * tickSize;
+    }
+
+    int levelFor(double price) const {
+        int64_t index = toTicks(price) - baseTick;
+        if (index < 0 || index >= static_cast<int64_t>(bidLevels.size())) {
+            std::cout << "Order rejected: price " << price << " outside " << symbol << " ladder" << std::endl;
+            return -1;
+        }
+        return static_cast<int>(index);
+    }
+
+    Level& levelOf(const Node& node) {
+        return node.isBuy ? bidLevels[node.levelIndex] : askLevels[node.levelIndex];
+    }
+
+    uint32_t internUser(const std::string& userID) {
+        auto it = userIndex.find(userID);
+        if (it != userIndex.end()) {
+            return it->second;
+        }
+        uint32_t index = static_cast<uint32_t>(users.size());
+        users.push_back(userID);
+        userIndex.emplace(userID, index);
+        return index;
+    }
+
+    void releaseNode(int32_t nodeIndex) {
+        nodes[nodeIndex].next = freeHead;
+        freeHead = nodeIndex;
+    }
+
+    // Fills one passive level for `aggressor` at that level's price; returns the aggressor if it
+    // still has quantity left, otherwise -1.
+    int32_t allocateAgainst(int32_t aggressor, int passiveIndex) {
+        PassiveLevel level(*this, aggressor, passiveIndex);
+        AllocationPolicy::allocate(level, nodes[aggressor].quantity);
+        if (nodes[aggressor].quantity == 0) {
+            retireFilled(aggressor);
+            return -1;
+        }
+        return aggressor;
+    }
+
+    void linkTail(int32_t nodeIndex, int index) {
+        Node& node = nodes[nodeIndex];
+        if constexpr (!AllocationPolicy::timePriorityOnly) {
+            lastLinked = nodeIndex;
+        }
+        node.levelIndex = index;
+        node.next = -1;
+        Level& level = levelOf(node);
+        node.prev = level.tail;
+        if (level.tail < 0) {
+            level.head = nodeIndex;
+            (node.isBuy ? bidBitmap : askBitmap).set(index);
+        } else {
+            nodes[level.tail].next = nodeIndex;
+        }
+        level.tail = nodeIndex;
+        level.totalQuantity += node.quantity;
+
+        if (node.isBuy && index > bestBidIndex) {
+            bestBidIndex = index;
+        } else if (!node.isBuy && (bestAskIndex < 0 || index < bestAskIndex)) {
+            bestAskIndex = index;
+        }
+    }
+
+    void unlink(int32_t nodeIndex) {
+        Node& node = nodes[nodeIndex];
+        Level& level = levelOf(node);
+        level.totalQuantity -= node.quantity;
+        if (node.prev < 0) {
+            level.head = node.next;
+        } else {
+            nodes[node.prev].next = node.next;
+        }
+        if (node.next < 0) {
+            level.tail = node.prev;
+        } else {
+            nodes[node.next].prev = node.prev;
+        }
+        if (level.head >= 0) {
+            return;
+        }
+
+        if (node.isBuy) {
+            bidBitmap.clear(node.levelIndex);
+            if (node.levelIndex == bestBidIndex) {
+                bestBidIndex = bidBitmap.highestAtOrBelow(bestBidIndex - 1);
+            }
+        } else {
+            askBitmap.clear(node.levelIndex);
+            if (node.levelIndex == bestAskIndex) {
+                bestAskIndex = askBitmap.lowestAtOrAbove(bestAskIndex + 1);
+            }
+        }
+    }
+
+    void retireFilled(int32_t nodeIndex) {
+        long orderId = nodes[nodeIndex].orderId;
+        if (orderId != 0) {
+            orderIndex.erase(orderId);
+            closedOrderIds.push_back(orderId);
+        }
+        unlink(nodeIndex);
+        releaseNode(nodeIndex);
+    }
+
+    bool removeUser(const Level& level, uint32_t user) {
+        bool orderFound = false;
+        int32_t nodeIndex = level.head;
+        while (nodeIndex >= 0) {
+            int32_t next = nodes[nodeIndex].next;
+            if (nodes[nodeIndex].userIndex == user) {
+                if (nodes[nodeIndex].orderId != 0) {
+                    orderIndex.erase(nodes[nodeIndex].orderId);
+                    closedOrderIds.push_back(nodes[nodeIndex].orderId);
+                }
+                unlink(nodeIndex);
+                releaseNode(nodeIndex);
+                orderFound = true;
+            }
+            nodeIndex = next;
+        }
+        return orderFound;
+    }
+
+    void executeTrade(const Node& buyNode, const Node& sellNode, double price, int quantity) const {
+        if (tradeSink) {
+            tradeSink->push_back({0, buyNode.orderId, sellNode.orderId, price, quantity, 0});
+        }
+        if (echoTrades) {
+            std::cout << "Trade Executed: " << quantity << " units of "
+                      << symbol << " at " << price << " price. "
+                      << "Buyer: " << users[buyNode.userIndex] << ", Seller: " << users[sellNode.userIndex] << std::endl;
+        }
+    }
+};
+
+using PriceLadderBook = BasicPriceLadderBook<FifoAllocation>;
+
+enum class JournalEvent : uint8_t {
+    PLACE = 1,
+    CANCEL = 2,
+    AMEND = 3,
+    CANCEL_USER = 4,
+    ENABLE_LADDER = 5
+};
+
+struct JournalRecord {
+    uint64_t sequence;
+    int64_t timestampNs;
+    int64_t orderId;
+    double price;
+    double auxPrice;
+    int32_t quantity;
+    uint8_t eventType;
+    uint8_t side;
+    uint16_t reserved;
+    char symbol[8];
+    char userID[24];
+};
+
+static_assert(sizeof(JournalRecord) == 80, "journal records must keep a fixed on-disk size");
+static_assert(sizeof(TradeRecord) == 40, "trade records must keep a fixed on-disk size");
+
+class EventJournal {
+public:
+    // Symbols and user ids are stored in fixed-width fields; a longer value would replay as a
+    // different, truncated one, so the exchange rejects it instead of journaling it.
+    static bool fits(const Order& order) {
+        return order.symbol.size() <= sizeof(JournalRecord::symbol) && order.userID.size() <= sizeof(JournalRecord::userID);
+    }
+
+    explicit EventJournal(const std::string& path)
+        : events(path, std::ios::binary | std::ios::trunc),
+          trades(path + ".trades", std::ios::binary | std::ios::trunc),
+          nextSequence(0) {}
+
+    uint64_t append(JournalEvent type, const Order& order, double auxPrice = 0) {
+        JournalRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.sequence = ++nextSequence;
+        // Monotonic, so replay pacing is unaffected by wall-clock steps.
+        record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        record.orderId = order.orderId;
+        record.price = order.price;
+        record.auxPrice = auxPrice;
+        record.quantity = order.quantity;
+        record.eventType = static_cast<uint8_t>(type);
+        record.side = order.orderType == Order::Type::BUY ? 0 : 1;
+        std::memcpy(record.symbol, order.symbol.data(), std::min(order.symbol.size(), sizeof(record.symbol)));
+        std::memcpy(record.userID, order.userID.data(), std::min(order.userID.size(), sizeof(record.userID)));
+        events.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        return record.sequence;
+    }
+
+    void appendTrades(uint64_t eventSequence, const std::vector<TradeRecord>& executed) {
+        for (TradeRecord trade : executed) {
+            trade.eventSequence = eventSequence;
+            trades.write(reinterpret_cast<const char*>(&trade), sizeof(trade));
+        }
+    }
+
+    void flush() {
+        events.flush();
+        trades.flush();
+    }
+
+private:
+    std::ofstream events;
+    std::ofstream trades;
+    uint64_t nextSequence;
 };
 
 class Exchange {
 public:
+    // A ladder book and its slot in orderRoutes, kept together so routing an order is one lookup.
+    struct LadderRoute {
+        std::unique_ptr<PriceLadderBook> book;
+        int32_t slot;
+    };
+
     OrderBook orderBook;
+    std::unordered_map<std::string, LadderRoute> ladderBooks;
+
+    Exchange() : nextOrderId(0), ladderSlots(1, nullptr), journal(nullptr), captureTrades(false), verbose(true) {}
+
+    void attachJournal(EventJournal* eventJournal) {
+        journal = eventJournal;
+        enableTradeCapture();
+    }
+
+    void enableTradeCapture() {
+        captureTrades = true;
+        orderBook.tradeSink = &capturedTrades;
+        for (size_t i = 1; i < ladderSlots.size(); ++i) {
+            ladderSlots[i]->tradeSink = &capturedTrades;
+        }
+    }
+
+    std::vector<TradeRecord>& trades() {
+        return capturedTrades;
+    }
+
+    void setVerbose(bool enabled) {
+        verbose = enabled;
+        orderBook.echoTrades = enabled;
+        for (size_t i = 1; i < ladderSlots.size(); ++i) {
+            ladderSlots[i]->echoTrades = enabled;
+        }
+    }
 
-    void placeOrder(const Order& order) {
+    // A symbol's ladder is fixed once enabled: replacing it would strand the orders resting in it,
+    // so a repeat call is rejected and returns false.
+    bool enableTickLadder(const std::string& symbol, double tickSize, double midPrice, int levelCount, size_t maxOrders) {
+        Order config(symbol, tickSize, levelCount, Order::Type::BUY, "", "", static_cast<long>(maxOrders));
+        if (!journalable(config)) {
+            return false;
+        }
+        if (ladderBooks.count(symbol)) {
+            if (verbose) {
+                std::cout << "Tick ladder already enabled for " << symbol << std::endl;
+            }
+            return false;
+        }
+        if (journal) {
+            journal->append(JournalEvent::ENABLE_LADDER, config, midPrice);
+        }
+        LadderRoute& ladder = ladderBooks[symbol];
+        ladder.book = std::make_unique<PriceLadderBook>(symbol, tickSize, midPrice, levelCount, maxOrders);
+        ladder.book->tradeSink = captureTrades ? &capturedTrades : nullptr;
+        ladder.book->echoTrades = verbose;
+        ladder.slot = static_cast<int32_t>(ladderSlots.size());
+        ladderSlots.push_back(ladder.book.get());
+        return true;
+    }
+
+    long placeOrder(Order order) {
+        if (!journalable(order)) {
+            return 0;
+        }
+        order.orderId = ++nextOrderId;
+        uint64_t sequence = journal ? journal->append(JournalEvent::PLACE, order) : 0;
+        auto ladder = ladderBooks.find(order.symbol);
+        if (ladder != ladderBooks.end()) {
+            PriceLadderBook& book = *ladder->second.book;
+            if (!book.addOrder(order)) {
+                return 0;
+            }
+            orderRoutes.insert(order.orderId, ladder->second.slot);
+            book.matchOrders();
+            forgetClosed(book.closedOrderIds);
+            journalTrades(sequence);
+            return order.orderId;
+        }
+        orderRoutes.insert(order.orderId, 0);
         orderBook.addOrder(order);
         orderBook.matchOrders();
+        forgetClosed(orderBook.closedOrderIds);
+        journalTrades(sequence);
+        return order.orderId;
+    }
+
+    bool cancelOrder(long orderId) {
+        if (journal) {
+            journal->append(JournalEvent::CANCEL, Order("", 0, 0, Order::Type::BUY, "", "", orderId));
+        }
+        int32_t slot = orderRoutes.find(orderId);
+        bool cancelled = false;
+        if (slot > 0) {
+            cancelled = ladderSlots[slot]->cancelOrder(orderId);
+        } else if (slot == 0) {
+            cancelled = orderBook.cancelOrder(orderId);
+        }
+        orderRoutes.erase(orderId);
+        if (verbose) {
+            std::cout << (cancelled ? "Order cancelled: #" : "Order not found: #") << orderId << std::endl;
+        }
+        return cancelled;
+    }
+
+    bool amendOrder(long orderId, int newQuantity, double newPrice) {
+        uint64_t sequence = 0;
+        if (journal) {
+            sequence = journal->append(JournalEvent::AMEND, Order("", newPrice, newQuantity, Order::Type::BUY, "", "", orderId));
+        }
+        int32_t slot = orderRoutes.find(orderId);
+        bool amended = false;
+        if (slot > 0) {
+            PriceLadderBook* ladder = ladderSlots[slot];
+            amended = ladder->amendOrder(orderId, newQuantity, newPrice);
+            ladder->matchOrders();
+            forgetClosed(ladder->closedOrderIds);
+        } else if (slot == 0) {
+            amended = orderBook.amendOrder(orderId, newQuantity, newPrice);
+            orderBook.matchOrders();
+            forgetClosed(orderBook.closedOrderIds);
+        }
+        if (amended && newQuantity <= 0) {
+            orderRoutes.erase(orderId);
+        }
+        journalTrades(sequence);
+        if (verbose) {
+            std::cout << (amended ? "Order amended: #" : "Order not found: #") << orderId << std::endl;
+        }
+        return amended;
     }
 
     void cancelOrder(const std::string& userID, const std::string& symbol) {
+        Order request(symbol, 0, 0, Order::Type::BUY, userID, "");
+        if (!journalable(request)) {
+            return;
+        }
+        if (journal) {
+            journal->append(JournalEvent::CANCEL_USER, request);
+        }
         bool orderFound = false;
-        for (auto& buyOrders : orderBook.buyOrders) {
-            std::queue<Order>& orders = buyOrders.second;
-            std::queue<Order> tempQueue;
-            while (!orders.empty()) {
-                if (orders.front().userID == userID && orders.front().symbol == symbol) {
-                    orders.pop();
-                    orderFound = true;
-                } else {
-                    tempQueue.push(orders.front());
-                    orders.pop();
-                }
-            }
-            buyOrders.second = tempQueue;
+        auto ladder = ladderBooks.find(symbol);
+        if (ladder != ladderBooks.end()) {
+            orderFound = ladder->second.book->cancelUserOrders(userID);
+            forgetClosed(ladder->second.book->closedOrderIds);
         }
-
-        for (auto& sellOrders : orderBook.sellOrders) {
-            std::queue<Order>& orders = sellOrders.second;
-            std::queue<Order> tempQueue;
-            while (!orders.empty()) {
-                if (orders.front().userID == userID && orders.front().symbol == symbol) {
-                    orders.pop();
-                    orderFound = true;
-                } else {
-                    tempQueue.push(orders.front());
-                    orders.pop();
+        for (auto side : {&orderBook.buyOrders, &orderBook.sellOrders}) {
+            for (auto level = side->begin(); level != side->end();) {
+                std::list<Order>& orders = level->second;
+                for (auto it = orders.begin(); it != orders.end();) {
+                    if (it->userID == userID && it->symbol == symbol) {
+                        orderBook.forgetOrder(it->orderId);
+                        it = orders.erase(it);
+                        orderFound = true;
+                    } else {
+                        ++it;
+                    }
                 }
+                level = orders.empty() ? side->erase(level) : std::next(level);
             }
-            sellOrders.second = tempQueue;
         }
+        forgetClosed(orderBook.closedOrderIds);
 
+        if (!verbose) {
+            return;
+        }
         if (orderFound) {
             std::cout << "Order cancelled for " << userID << " on " << symbol << std::endl;
         } else {
             std::cout << "Order not found for " << userID << " on " << symbol << std::endl;
         }
     }
+
+private:
+    long nextOrderId;
+    OrderIdIndex orderRoutes;
+    std::vector<PriceLadderBook*> ladderSlots;
+    EventJournal* journal;
+    bool captureTrades;
+    bool verbose;
+    std::vector<TradeRecord> capturedTrades;
+
+    bool journalable(const Order& order) const {
+        if (!journal || EventJournal::fits(order)) {
+            return true;
+        }
+        if (verbose) {
+            std::cout << "Rejected: symbol or user id too long for the journal (" << order.symbol << ", " << order.userID
+                      << ")" << std::endl;
+        }
+        return false;
+    }
+
+    void journalTrades(uint64_t sequence) {
+        if (journal) {
+            journal->appendTrades(sequence, capturedTrades);
+            capturedTrades.clear();
+        }
+    }
+
+    void forgetClosed(std::vector<long>& closedOrderIds) {
+        for (long orderId : closedOrderIds) {
+            orderRoutes.erase(orderId);
+        }
+        closedOrderIds.clear();
+    }
+};
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data(nullptr), length(0) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const char*>(mapped);
+                length = static_cast<size_t>(info.st_size);
+            }
+        }
+        close(fd);
+#else
+        std::ifstream file(path, std::ios::binary);
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = fallback.data();
+        length = fallback.size();
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data) {
+            munmap(const_cast<char*>(data), length);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    template <typename Record>
+    const Record* records() const { return reinterpret_cast<const Record*>(data); }
+
+    template <typename Record>
+    size_t count() const { return length / sizeof(Record); }
+
+private:
+    const char* data;
+    size_t length;
+#ifdef _WIN32
+    std::vector<char> fallback;
+#endif
+};
+
+struct ReplayReport {
+    uint64_t events = 0;
+    uint64_t trades = 0;
+    uint64_t mismatches = 0;
+    double seconds = 0;
+    double eventsPerSecond = 0;
+};
+
+class JournalReplayer {
+public:
+    // timeScale 0 replays as fast as possible; 1.0 reproduces the recorded pacing, 10.0 runs ten times faster.
+    static ReplayReport replay(const std::string& path, double timeScale = 0) {
+        MappedFile eventFile(path);
+        MappedFile tradeFile(path + ".trades");
+        const JournalRecord* events = eventFile.records<JournalRecord>();
+        const TradeRecord* expected = tradeFile.records<TradeRecord>();
+        size_t eventCount = eventFile.count<JournalRecord>();
+        size_t expectedCount = tradeFile.count<TradeRecord>();
+        size_t nextExpected = 0;
+
+        Exchange exchange;
+        exchange.setVerbose(false);
+        exchange.enableTradeCapture();
+
+        ReplayReport report;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < eventCount; ++i) {
+            const JournalRecord& record = events[i];
+            if (timeScale > 0) {
+                auto offset = std::chrono::nanoseconds(static_cast<int64_t>((record.timestampNs - events[0].timestampNs) / timeScale));
+                std::this_thread::sleep_until(start + offset);
+            }
+            apply(exchange, record);
+
+            for (const TradeRecord& trade : exchange.trades()) {
+                bool matches = nextExpected < expectedCount
+                    && expected[nextExpected].eventSequence == record.sequence
+                    && expected[nextExpected].buyOrderId == trade.buyOrderId
+                    && expected[nextExpected].sellOrderId == trade.sellOrderId
+                    && expected[nextExpected].price == trade.price
+                    && expected[nextExpected].quantity == trade.quantity;
+                report.mismatches += matches ? 0 : 1;
+                ++nextExpected;
+                ++report.trades;
+            }
+            exchange.trades().clear();
+            ++report.events;
+        }
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report.mismatches += expectedCount > nextExpected ? expectedCount - nextExpected : 0;
+        report.eventsPerSecond = report.seconds > 0 ? report.events / report.seconds : 0;
+        return report;
+    }
+
+private:
+    static std::string field(const char* text, size_t size) {
+        return std::string(text, strnlen(text, size));
+    }
+
+    static void apply(Exchange& exchange, const JournalRecord& record) {
+        std::string symbol = field(record.symbol, sizeof(record.symbol));
+        switch (static_cast<JournalEvent>(record.eventType)) {
+        case JournalEvent::PLACE:
+            exchange.placeOrder(Order(symbol, record.price, record.quantity,
+                                      record.side == 0 ? Order::Type::BUY : Order::Type::SELL,
+                                      field(record.userID, sizeof(record.userID)), ""));
+            break;
+        case JournalEvent::CANCEL:
+            exchange.cancelOrder(static_cast<long>(record.orderId));
+            break;
+        case JournalEvent::AMEND:
+            exchange.amendOrder(static_cast<long>(record.orderId), record.quantity, record.price);
+            break;
+        case JournalEvent::CANCEL_USER:
+            exchange.cancelOrder(field(record.userID, sizeof(record.userID)), symbol);
+            break;
+        case JournalEvent::ENABLE_LADDER:
+            exchange.enableTickLadder(symbol, record.price, record.auxPrice, record.quantity,
+                                      static_cast<size_t>(record.orderId));
+            break;
+        }
+    }
 };
 
 class Broker {
@@ -135,22 +1078,45 @@ private:
     Exchange exchange;
 
 public:
-    void submitBuyOrder(const std::string& symbol, double price, int quantity, const std::string& userID, const std::string& timestamp) {
+    long submitBuyOrder(const std::string& symbol, double price, int quantity, const std::string& userID, const std::string& timestamp) {
         Order order(symbol, price, quantity, Order::Type::BUY, userID, timestamp);
-        exchange.placeOrder(order);
+        return exchange.placeOrder(order);
     }
 
-    void submitSellOrder(const std::string& symbol, double price, int quantity, const std::string& userID, const std::string& timestamp) {
+    long submitSellOrder(const std::string& symbol, double price, int quantity, const std::string& userID, const std::string& timestamp) {
         Order order(symbol, price, quantity, Order::Type::SELL, userID, timestamp);
-        exchange.placeOrder(order);
+        return exchange.placeOrder(order);
     }
 
     void cancelOrder(const std::string& userID, const std::string& symbol) {
         exchange.cancelOrder(userID, symbol);
     }
 
+    bool cancelOrder(long orderId) {
+        return exchange.cancelOrder(orderId);
+    }
+
+    bool amendOrder(long orderId, int newQuantity, double newPrice) {
+        return exchange.amendOrder(orderId, newQuantity, newPrice);
+    }
+
+    bool enableTickLadder(const std::string& symbol, double tickSize, double midPrice, int levelCount, size_t maxOrders) {
+        return exchange.enableTickLadder(symbol, tickSize, midPrice, levelCount, maxOrders);
+    }
+
+    void attachJournal(EventJournal* journal) {
+        exchange.attachJournal(journal);
+    }
+
+    void setVerbose(bool enabled) {
+        exchange.setVerbose(enabled);
+    }
+
     void displayOrderBook() const {
         exchange.orderBook.printOrderBook();
+        for (const auto& ladder : exchange.ladderBooks) {
+            ladder.second.book->printOrderBook();
+        }
     }
 };
 
@@ -161,9 +1127,9 @@ int main() {
     broker.submitSellOrder("AAPL", 149.50, 50, "user2", "2025-03-15 10:01");
     broker.submitSellOrder("AAPL", 149.50, 60, "user3", "2025-03-15 10:02");
     broker.submitBuyOrder("AAPL", 149.50, 50, "user4", "2025-03-15 10:03");
-    
+
     broker.displayOrderBook();
-    
+
     broker.cancelOrder("user2", "AAPL");
 
     broker.displayOrderBook();
@@ -171,6 +1137,56 @@ int main() {
     broker.submitBuyOrder("AAPL", 149.60, 100, "user5", "2025-03-15 10:05");
     broker.submitSellOrder("AAPL", 149.60, 100, "user6", "2025-03-15 10:06");
     broker.displayOrderBook();
-    
+
+    Broker ladderBroker;
+    ladderBroker.enableTickLadder("AAPL", 0.01, 150.00, 4096, 1024);
+
+    ladderBroker.submitBuyOrder("AAPL", 150.00, 100, "user1", "2025-03-15 10:00");
+    ladderBroker.submitSellOrder("AAPL", 149.50, 50, "user2", "2025-03-15 10:01");
+    ladderBroker.submitSellOrder("AAPL", 149.50, 60, "user3", "2025-03-15 10:02");
+    ladderBroker.submitBuyOrder("AAPL", 149.50, 50, "user4", "2025-03-15 10:03");
+
+    ladderBroker.cancelOrder("user2", "AAPL");
+    ladderBroker.enableTickLadder("AAPL", 0.05, 150.00, 1024, 1024);
+
+    ladderBroker.submitBuyOrder("AAPL", 149.60, 100, "user5", "2025-03-15 10:05");
+    ladderBroker.submitSellOrder("AAPL", 149.60, 100, "user6", "2025-03-15 10:06");
+    ladderBroker.displayOrderBook();
+
+    for (Broker* book : {&broker, &ladderBroker}) {
+        long restingBid = book->submitBuyOrder("AAPL", 149.00, 40, "user7", "2025-03-15 10:07");
+        long restingAsk = book->submitSellOrder("AAPL", 151.00, 30, "user8", "2025-03-15 10:08");
+        book->amendOrder(restingBid, 25, 149.00);
+        book->amendOrder(restingAsk, 30, 149.50);
+        book->cancelOrder(restingBid);
+        book->displayOrderBook();
+    }
+
+    {
+        EventJournal journal("broker_journal.bin");
+        Broker recorded;
+        recorded.attachJournal(&journal);
+        recorded.setVerbose(false);
+        recorded.enableTickLadder("MSFT", 0.01, 400.00, 2048, 4096);
+        for (int i = 0; i < 2000; ++i) {
+            const char* symbol = (i % 3 == 0) ? "AAPL" : "MSFT";
+            double price = (i % 3 == 0 ? 150.00 : 400.00) + ((i * 7) % 21 - 10) * 0.01;
+            std::string user = "user" + std::to_string(i % 17);
+            long orderId = (i % 2 == 0) ? recorded.submitBuyOrder(symbol, price, 10 + i % 40, user, "")
+                                        : recorded.submitSellOrder(symbol, price, 10 + i % 40, user, "");
+            if (i % 5 == 0) {
+                recorded.cancelOrder(orderId);
+            } else if (i % 7 == 0) {
+                recorded.amendOrder(orderId, 5, price);
+            }
+        }
+        journal.flush();
+    }
+
+    ReplayReport report = JournalReplayer::replay("broker_journal.bin");
+    std::cout << "Replayed " << report.events << " events and " << report.trades << " trades in "
+              << report.seconds * 1000.0 << " ms (" << report.eventsPerSecond << " events/s), "
+              << report.mismatches << " trade mismatches" << std::endl;
+
     return 0;
 }
@@ -6,6 +6,13 @@
 #include <ctime>
 #include <cstdlib>
 #include <cmath>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+#include "order_book.h"
+#include "market_depth.h"
+#include "latency_clock.h"
 
 class Order {
 public:
@@ -15,11 +22,13 @@ public:
     double quantity;
     std::string side; 
     std::string exchange;
-    time_t timestamp;
+    uint64_t timestamp;  // timing::NanoClock nanoseconds at ingress.
+    timing::StageStamps stamps;
 
     Order(std::string id, std::string sym, double pr, double qty, std::string s, std::string ex)
         : orderId(id), symbol(sym), price(pr), quantity(qty), side(s), exchange(ex) {
-        timestamp = std::time(0);
+        stamps.stamp(timing::Stage::INGRESS);
+        timestamp = stamps[timing::Stage::INGRESS];
     }
 
     void printOrder() const {
@@ -49,95 +58,171 @@ public:
     }
 };
 
+// Prints matches and republishes every level change to the depth-delta ring. While an order is
+// being added, its stamps record the last fill (match) and the last depth delta (publish), and the
+// ids of every order it traded with are collected so filled ones can be forgotten.
+class DepthPublisher {
+public:
+    explicit DepthPublisher(market_depth::DepthDeltaRing* ring) : ring(ring), inFlight(nullptr), traded(nullptr) {}
+
+    void track(timing::StageStamps* stamps, std::vector<uint64_t>* tradedIds) {
+        inFlight = stamps;
+        traded = tradedIds;
+    }
+
+    void onTrade(uint64_t buyId, uint64_t sellId, double price, double quantity) {
+        if (inFlight) {
+            inFlight->stamp(timing::Stage::MATCH);
+        }
+        if (traded) {
+            traded->push_back(buyId);
+            traded->push_back(sellId);
+        }
+        std::cout << "Match: " << quantity << " units at price " << price << std::endl;
+    }
+
+    void onLevelChanged(matching::Side side, double price, double quantity, size_t orderCount) {
+        ring->publish(side == matching::Side::BUY, price, quantity, static_cast<uint32_t>(orderCount));
+        if (inFlight) {
+            inFlight->stamp(timing::Stage::PUBLISH);
+        }
+    }
+
+private:
+    market_depth::DepthDeltaRing* ring;
+    timing::StageStamps* inFlight;
+    std::vector<uint64_t>* traded;
+};
+
+// Keeps the string-keyed interface of this simulator on top of the shared matching::OrderBook; the
+// side string is parsed once per call and order ids are interned to integers.
 class OrderBook {
 private:
-    std::map<double, std::queue<Order>> buyOrders;
-    std::map<double, std::queue<Order>> sellOrders;
+    using Book = matching::OrderBook<matching::DoublePrice, matching::MapLevels, matching::FifoAllocation, DepthPublisher, double>;
+
+    market_depth::DepthDeltaRing depthDeltas;
+    Book book;
+    std::unordered_map<std::string, uint64_t> orderIds;
+    std::unordered_map<uint64_t, std::string> orderNames;
+    std::vector<uint64_t> tradedIds;
+    uint64_t nextOrderId;
+
+    // Drops both mappings of an order that is no longer in the book. A string id re-used for a
+    // newer order keeps pointing at that order.
+    void forget(uint64_t id) {
+        auto name = orderNames.find(id);
+        if (name == orderNames.end()) {
+            return;
+        }
+        auto it = orderIds.find(name->second);
+        if (it != orderIds.end() && it->second == id) {
+            orderIds.erase(it);
+        }
+        orderNames.erase(name);
+    }
+
+    static bool parseSide(const std::string& side, matching::Side& parsed) {
+        if (side == "BUY" || side == "SELL") {
+            parsed = side == "BUY" ? matching::Side::BUY : matching::Side::SELL;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<market_depth::DepthLevel> collectDepth(matching::Side side, size_t levels) const {
+        std::vector<market_depth::DepthLevel> depth;
+        book.visitLevels(side, levels, [&depth](double price, double quantity, size_t orderCount) {
+            depth.push_back({price, quantity, orderCount});
+        });
+        return depth;
+    }
+
+    void printSide(matching::Side side) const {
+        book.visitLevels(side, static_cast<size_t>(-1), [](double price, double quantity, size_t orderCount) {
+            std::cout << "Price: " << price << ", Quantity: " << quantity << ", Orders: " << orderCount << std::endl;
+        });
+    }
 
 public:
+    OrderBook() : book(0, 0, DepthPublisher(&depthDeltas)), nextOrderId(1) {}
+
+    // Orders match as they are added, so the book never rests crossed.
     void addOrder(const Order& order) {
-        if (order.side == "BUY") {
-            buyOrders[order.price].push(order);
-        } else if (order.side == "SELL") {
-            sellOrders[order.price].push(order);
-        }
+        timing::StageStamps stamps = order.stamps;
+        addOrder(order, stamps);
     }
 
-    void removeOrder(const std::string& orderId, const std::string& side) {
-        if (side == "BUY") {
-            for (auto& [price, queue] : buyOrders) {
-                if (!queue.empty() && queue.front().orderId == orderId) {
-                    queue.pop();
-                    break;
-                }
-            }
-        } else if (side == "SELL") {
-            for (auto& [price, queue] : sellOrders) {
-                if (!queue.empty() && queue.front().orderId == orderId) {
-                    queue.pop();
-                    break;
-                }
+    bool addOrder(const Order& order, timing::StageStamps& stamps) {
+        matching::Side side;
+        if (!parseSide(order.side, side)) {
+            return false;
+        }
+        uint64_t id = nextOrderId++;
+        orderIds[order.orderId] = id;
+        orderNames[id] = order.orderId;
+        stamps.stamp(timing::Stage::DECODE);
+        book.listener().track(&stamps, &tradedIds);
+        book.add(id, side, order.price, order.quantity);
+        book.listener().track(nullptr, nullptr);
+        tradedIds.push_back(id);
+        for (uint64_t traded : tradedIds) {
+            if (!book.contains(traded)) {
+                forget(traded);
             }
         }
+        tradedIds.clear();
+        return true;
     }
 
-    void matchOrders() {
-        while (!buyOrders.empty() && !sellOrders.empty()) {
-            auto buyIt = buyOrders.rbegin();
-            auto sellIt = sellOrders.begin();
-
-            if (buyIt->first >= sellIt->first) {
-                double price = sellIt->first;
-                double quantity = std::min(buyIt->second.front().quantity, sellIt->second.front().quantity);
-
-                std::cout << "Match: " << quantity << " units at price " << price << std::endl;
-
-            
-                buyIt->second.front().quantity -= quantity;
-                sellIt->second.front().quantity -= quantity;
-
-                
-                if (buyIt->second.front().quantity == 0) {
-                    buyIt->second.pop();
-                    if (buyIt->second.empty()) {
-                        buyOrders.erase(buyIt->first);
-                    }
-                }
-
-                if (sellIt->second.front().quantity == 0) {
-                    sellIt->second.pop();
-                    if (sellIt->second.empty()) {
-                        sellOrders.erase(sellIt->first);
-                    }
-                }
-            } else {
-                break;
-            }
+    void removeOrder(const std::string& orderId, const std::string& side) {
+        matching::Side parsed;
+        auto it = orderIds.find(orderId);
+        if (parseSide(side, parsed) && it != orderIds.end()) {
+            uint64_t id = it->second;
+            book.cancel(id);
+            forget(id);
         }
     }
 
+
+    market_depth::DepthSnapshot depthSnapshot(size_t levels) const {
+        market_depth::DepthSnapshot snapshot;
+        snapshot.bids = collectDepth(matching::Side::BUY, levels);
+        snapshot.asks = collectDepth(matching::Side::SELL, levels);
+        snapshot.sequence = depthDeltas.lastSequence();
+        return snapshot;
+    }
+
+    const market_depth::DepthDeltaRing& deltas() const {
+        return depthDeltas;
+    }
+
     void printOrderBook() const {
         std::cout << "\nOrder Book:" << std::endl;
         std::cout << "Buy Orders:" << std::endl;
-        for (auto& [price, queue] : buyOrders) {
-            std::cout << "Price: " << price << ", Quantity: " << queue.size() << std::endl;
-        }
+        printSide(matching::Side::BUY);
 
         std::cout << "Sell Orders:" << std::endl;
-        for (auto& [price, queue] : sellOrders) {
-            std::cout << "Price: " << price << ", Quantity: " << queue.size() << std::endl;
-        }
+        printSide(matching::Side::SELL);
     }
 };
 
 class CrossBorderTradingSystem {
 private:
     OrderBook orderBook;
+    timing::StageLatencyReport latencies;
 
 public:
+    // There is no pre-trade risk check in this simulator, so orders carry no risk stamp.
     void placeOrder(const Order& order) {
-        orderBook.addOrder(order);
-        orderBook.matchOrders();
+        timing::StageStamps stamps = order.stamps;
+        if (orderBook.addOrder(order, stamps)) {
+            latencies.record(stamps);
+        }
+    }
+
+    void printLatencyReport() const {
+        latencies.print(std::cout);
     }
 
     void cancelOrder(const std::string& orderId, const std::string& side) {
@@ -148,6 +233,14 @@ public:
         orderBook.printOrderBook();
     }
 
+    market_depth::DepthSnapshot depth(size_t levels) const {
+        return orderBook.depthSnapshot(levels);
+    }
+
+    const market_depth::DepthDeltaRing& depthDeltas() const {
+        return orderBook.deltas();
+    }
+
     double applyTransactionFee(double amount, const std::string& exchange) {
         std::map<std::string, double> fees = {
             {"NYSE", 0.002}, 
@@ -205,5 +298,17 @@ int main() {
     CrossBorderTradingSystem tradingSystem;
     MarketData::simulateMarket(tradingSystem, "AAPL", "USD", "EUR");
 
+    market_depth::DepthSnapshot snapshot = tradingSystem.depth(5);
+    for (const auto& level : snapshot.bids) {
+        std::cout << "Bid " << level.price << " x " << level.quantity << " (" << level.orderCount << " orders)" << std::endl;
+    }
+    std::vector<market_depth::LevelDelta> deltas;
+    tradingSystem.depthDeltas().readSince(snapshot.sequence > 5 ? snapshot.sequence - 5 : 0, deltas);
+    for (const auto& delta : deltas) {
+        std::cout << "Delta #" << delta.sequence << " " << (delta.isBuy ? "BID " : "ASK ") << delta.price
+                  << " -> " << delta.quantity << std::endl;
+    }
+    tradingSystem.printLatencyReport();
+
     return 0;
 }
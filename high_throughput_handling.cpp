@@ -8,17 +8,21 @@
 #include <ctime>
 #include <chrono>
 
+#include "latency_clock.h"
+
 class Transaction {
 public:
     std::string transactionId;
     std::string symbol;
     double amount;
     double price;
-    time_t timestamp;
+    uint64_t timestamp;  // timing::NanoClock nanoseconds at ingress.
+    timing::StageStamps stamps;
 
     Transaction(std::string id, std::string sym, double amt, double pr)
         : transactionId(id), symbol(sym), amount(amt), price(pr) {
-        timestamp = std::time(0);
+        stamps.stamp(timing::Stage::INGRESS);
+        timestamp = stamps[timing::Stage::INGRESS];
     }
 
     void printTransaction() const {
@@ -35,6 +39,8 @@ private:
     std::queue<Transaction> transactions;
     std::mutex queueMutex;
     std::atomic<int> processedCount;
+    std::mutex reportMutex;
+    timing::StageLatencyReport latencies;
 
 public:
     TransactionQueue() : processedCount(0) {}
@@ -44,16 +50,29 @@ public:
         transactions.push(transaction);
     }
 
+    // Nothing is decoded or matched here: the only stage between ingress and the console is the
+    // queue, stamped as the transaction leaves it. The queue lock is released before any printing.
     bool processTransaction() {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        if (!transactions.empty()) {
-            Transaction transaction = transactions.front();
-            transactions.pop();
-            processedCount++;
-            transaction.printTransaction();
-            return true;
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (transactions.empty()) {
+            return false;
+        }
+        Transaction transaction = std::move(transactions.front());
+        transactions.pop();
+        lock.unlock();
+
+        transaction.stamps.stamp(timing::Stage::QUEUE);
+        int processed = ++processedCount;
+        transaction.printTransaction();
+
+        std::unique_lock<std::mutex> reportLock(reportMutex);
+        latencies.record(transaction.stamps);
+        if (processed % 1000 == 0) {
+            timing::StageLatencyReport report = latencies;
+            reportLock.unlock();
+            report.print(std::cout);
         }
-        return false;
+        return true;
     }
 
     int getProcessedCount() const {
@@ -133,6 +152,7 @@ public:
 
 int main() {
     srand(time(0));
+    timing::NanoClock::calibrate();
 
     HighThroughputSystem system;
     system.start();
@@ -0,0 +1,244 @@
+#ifndef LATENCY_CLOCK_H
+#define LATENCY_CLOCK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define LATENCY_CLOCK_HAS_TSC 1
+#endif
+
+// Monotonic nanosecond timestamps as plain 64-bit integers, and per-stage latency reporting built
+// on them:
+//
+//     timing::StageStamps stamps;
+//     stamps.stamp(timing::Stage::INGRESS);
+//     ...
+//     stamps.stamp(timing::Stage::PUBLISH);
+//     report.record(stamps);
+namespace timing {
+
+// Reads the invariant TSC and scales it to nanoseconds with a fixed-point multiplier calibrated
+// against steady_clock on first use, so a stamp costs a few nanoseconds and no system call. Values
+// share steady_clock's epoch. Without an invariant TSC it falls back to steady_clock.
+class NanoClock {
+public:
+    static uint64_t now() {
+#ifdef LATENCY_CLOCK_HAS_TSC
+        const Calibration& scale = calibration();
+        if (scale.useTsc) {
+            // A core whose TSC reads slightly behind the calibration point clamps to it rather
+            // than wrapping to a huge timestamp.
+            uint64_t ticks = __rdtsc();
+            uint64_t elapsedTicks = ticks > scale.baseTicks ? ticks - scale.baseTicks : 0;
+            unsigned __int128 elapsed = static_cast<unsigned __int128>(elapsedTicks) * scale.multiplier;
+            return scale.baseNanos + static_cast<uint64_t>(elapsed >> SHIFT);
+        }
+#endif
+        return steadyNanos();
+    }
+
+    // Calibration spins for about 10 ms; call this at startup to keep it out of the first stamp.
+    static void calibrate() {
+        calibration();
+    }
+
+    static bool usesTsc() {
+        return calibration().useTsc;
+    }
+
+    static double ticksPerNanosecond() {
+        return calibration().ticksPerNanosecond;
+    }
+
+private:
+    static const unsigned SHIFT = 32;
+
+    struct Calibration {
+        bool useTsc;
+        uint64_t baseTicks;
+        uint64_t baseNanos;
+        uint64_t multiplier;
+        double ticksPerNanosecond;
+    };
+
+    static uint64_t steadyNanos() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static const Calibration& calibration() {
+        static const Calibration scale = measure();
+        return scale;
+    }
+
+    static Calibration measure() {
+        Calibration scale{false, 0, 0, 0, 0.0};
+#ifdef LATENCY_CLOCK_HAS_TSC
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+            return scale;
+        }
+        uint64_t startNanos = steadyNanos();
+        uint64_t startTicks = __rdtsc();
+        uint64_t endNanos = startNanos;
+        while (endNanos - startNanos < 10000000) {
+            endNanos = steadyNanos();
+        }
+        uint64_t endTicks = __rdtsc();
+        if (endTicks <= startTicks) {
+            return scale;
+        }
+        scale.ticksPerNanosecond = static_cast<double>(endTicks - startTicks) / static_cast<double>(endNanos - startNanos);
+        scale.multiplier = static_cast<uint64_t>(std::ldexp(1.0 / scale.ticksPerNanosecond, SHIFT));
+        scale.baseTicks = endTicks;
+        scale.baseNanos = endNanos;
+        scale.useTsc = true;
+#endif
+        return scale;
+    }
+};
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(BUCKETS, 0), total(0), maxValue(0) {}
+
+    void record(uint64_t nanos) {
+        ++counts[bucketFor(nanos)];
+        ++total;
+        maxValue = std::max(maxValue, nanos);
+    }
+
+    uint64_t percentile(double p) const {
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p * total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank && seen > 0) {
+                return std::min(valueFor(i), maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+
+private:
+    // Log-linear buckets: exact below 128 ns, then 64 sub-buckets per power of two (~1.5% error).
+    static const size_t BUCKETS = 64 * 60;
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t maxValue;
+
+    static size_t bucketFor(uint64_t value) {
+        if (value < 128) {
+            return static_cast<size_t>(value);
+        }
+        int exponent = 63 - __builtin_clzll(value) - 6;
+        return static_cast<size_t>(exponent) * 64 + static_cast<size_t>(value >> exponent);
+    }
+
+    static uint64_t valueFor(size_t bucket) {
+        if (bucket < 128) {
+            return bucket;
+        }
+        size_t exponent = bucket / 64 - 1;
+        return static_cast<uint64_t>(bucket - exponent * 64) << exponent;
+    }
+};
+
+// QUEUE marks the moment a message leaves whatever queue or batch it waited in, so that wait is
+// reported on its own rather than charged to the stage after it.
+enum class Stage : uint8_t { INGRESS, QUEUE, DECODE, RISK, MATCH, PUBLISH };
+
+const size_t STAGE_COUNT = 6;
+
+inline const char* stageName(size_t stage) {
+    static const char* const names[STAGE_COUNT] = {"ingress", "queue", "decode", "risk", "match", "publish"};
+    return stage < STAGE_COUNT ? names[stage] : "?";
+}
+
+// Carried with a message through the pipeline. A stage left at zero was not passed through, and
+// the report measures across it.
+struct StageStamps {
+    uint64_t at[STAGE_COUNT] = {0, 0, 0, 0, 0, 0};
+
+    void stamp(Stage stage) {
+        at[static_cast<size_t>(stage)] = NanoClock::now();
+    }
+
+    void stamp(Stage stage, uint64_t nanos) {
+        at[static_cast<size_t>(stage)] = nanos;
+    }
+
+    uint64_t operator[](Stage stage) const {
+        return at[static_cast<size_t>(stage)];
+    }
+};
+
+// For each stage, the time from the previous stamped stage to it, plus first stamp to last stamp.
+class StageLatencyReport {
+public:
+    void record(const StageStamps& stamps) {
+        uint64_t first = 0;
+        uint64_t previous = 0;
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            uint64_t at = stamps.at[stage];
+            if (at == 0) {
+                continue;
+            }
+            if (previous == 0) {
+                first = at;
+            } else {
+                stages[stage].record(at > previous ? at - previous : 0);
+            }
+            previous = at;
+        }
+        if (previous != first) {
+            endToEnd.record(previous - first);
+        }
+    }
+
+    const LatencyHistogram& stage(Stage stage) const {
+        return stages[static_cast<size_t>(stage)];
+    }
+
+    const LatencyHistogram& total() const {
+        return endToEnd;
+    }
+
+    void print(std::ostream& out) const {
+        out << std::left << std::setw(10) << "stage" << std::right << std::setw(10) << "count" << std::setw(10)
+            << "p50 ns" << std::setw(10) << "p99 ns" << std::setw(12) << "p99.9 ns" << std::setw(12) << "max ns" << '\n';
+        for (size_t stage = 1; stage < STAGE_COUNT; ++stage) {
+            if (stages[stage].count() > 0) {
+                printRow(out, stageName(stage), stages[stage]);
+            }
+        }
+        printRow(out, "total", endToEnd);
+        out << "(clock: " << (NanoClock::usesTsc() ? "TSC" : "steady_clock") << ")" << std::endl;
+    }
+
+private:
+    LatencyHistogram stages[STAGE_COUNT];
+    LatencyHistogram endToEnd;
+
+    static void printRow(std::ostream& out, const char* label, const LatencyHistogram& histogram) {
+        out << std::left << std::setw(10) << label << std::right << std::setw(10) << histogram.count() << std::setw(10)
+            << histogram.percentile(0.50) << std::setw(10) << histogram.percentile(0.99) << std::setw(12)
+            << histogram.percentile(0.999) << std::setw(12) << histogram.max() << '\n';
+    }
+};
+
+}  // namespace timing
+
+#endif
@@ -4,10 +4,13 @@
 #include <random>
 #include <algorithm>
 #include <ctime>
+#include <cstdint>
+#include <cstdlib>
 
 class Order {
 public:
     enum class Type { BUY, SELL };
+    Order() : id(0), type(Type::BUY), price(0.0), quantity(0) {}
     Order(int id, Type type, double price, int quantity)
         : id(id), type(type), price(price), quantity(quantity) {}
 
@@ -15,50 +18,137 @@ public:
     Type type;
     double price;
     int quantity;
+};
 
-    bool operator<(const Order& other) const {
-        
-        if (type == Type::BUY && other.type == Type::BUY)
-            return price < other.price;
-        
-        if (type == Type::SELL && other.type == Type::SELL)
-            return price > other.price;
-        return false;
+class OrderPool {
+public:
+    typedef uint32_t Handle;
+    static const Handle INVALID_HANDLE = UINT32_MAX;
+
+    explicit OrderPool(uint32_t capacity)
+        : records(capacity), sequences(capacity, 0), freeHandles(capacity), liveCount(0), peakCount(0) {
+        for (uint32_t i = 0; i < capacity; ++i) {
+            freeHandles[i] = capacity - 1 - i;
+        }
     }
+
+    Handle allocate(const Order& order, uint64_t sequence) {
+        if (freeHandles.empty()) {
+            return INVALID_HANDLE;
+        }
+        Handle handle = freeHandles.back();
+        freeHandles.pop_back();
+        records[handle] = order;
+        sequences[handle] = sequence;
+        if (++liveCount > peakCount) {
+            peakCount = liveCount;
+        }
+        return handle;
+    }
+
+    void release(Handle handle) {
+        freeHandles.push_back(handle);
+        --liveCount;
+    }
+
+    Order& get(Handle handle) { return records[handle]; }
+    const Order& get(Handle handle) const { return records[handle]; }
+    uint64_t sequence(Handle handle) const { return sequences[handle]; }
+
+    uint32_t capacity() const { return static_cast<uint32_t>(records.size()); }
+    uint32_t inUse() const { return liveCount; }
+    uint32_t highWaterMark() const { return peakCount; }
+
+private:
+    std::vector<Order> records;
+    std::vector<uint64_t> sequences;
+    std::vector<Handle> freeHandles;
+    uint32_t liveCount;
+    uint32_t peakCount;
 };
 
 class OrderBook {
 public:
-    void addOrder(Order order) {
-        if (order.type == Order::Type::BUY)
-            buyOrders.push(order);
-        else
-            sellOrders.push(order);
+    explicit OrderBook(uint32_t poolCapacity) : orders(poolCapacity), nextSequence(0) {
+        buyOrders.reserve(poolCapacity);
+        sellOrders.reserve(poolCapacity);
+    }
+
+    bool addOrder(const Order& order) {
+        OrderPool::Handle handle = orders.allocate(order, nextSequence++);
+        if (handle == OrderPool::INVALID_HANDLE) {
+            std::cout << "Order #" << order.id << " rejected: order pool exhausted" << std::endl;
+            return false;
+        }
+        if (order.type == Order::Type::BUY) {
+            buyOrders.push_back(handle);
+            std::push_heap(buyOrders.begin(), buyOrders.end(), BuyPriority{orders});
+        } else {
+            sellOrders.push_back(handle);
+            std::push_heap(sellOrders.begin(), sellOrders.end(), SellPriority{orders});
+        }
+        return true;
     }
 
     void matchOrders() {
         while (!buyOrders.empty() && !sellOrders.empty()) {
-            Order buyOrder = buyOrders.top();
-            Order sellOrder = sellOrders.top();
+            Order& buyOrder = orders.get(buyOrders.front());
+            Order& sellOrder = orders.get(sellOrders.front());
 
             if (buyOrder.price >= sellOrder.price) {
-               
+                int quantity = std::min(buyOrder.quantity, sellOrder.quantity);
                 std::cout << "Matched Order: Buy Order #" << buyOrder.id
                           << " with Sell Order #" << sellOrder.id
-                          << " at price " << sellOrder.price << std::endl;
-
-               
-                buyOrders.pop();
-                sellOrders.pop();
+                          << " at price " << sellOrder.price
+                          << " for " << quantity << " shares" << std::endl;
+
+                buyOrder.quantity -= quantity;
+                sellOrder.quantity -= quantity;
+                if (buyOrder.quantity == 0) {
+                    std::pop_heap(buyOrders.begin(), buyOrders.end(), BuyPriority{orders});
+                    orders.release(buyOrders.back());
+                    buyOrders.pop_back();
+                }
+                if (sellOrder.quantity == 0) {
+                    std::pop_heap(sellOrders.begin(), sellOrders.end(), SellPriority{orders});
+                    orders.release(sellOrders.back());
+                    sellOrders.pop_back();
+                }
             } else {
                 break; // No more matches possible
             }
         }
     }
 
+    const OrderPool& pool() const { return orders; }
+
 private:
-    std::priority_queue<Order> buyOrders;
-    std::priority_queue<Order> sellOrders;
+    struct BuyPriority {
+        const OrderPool& pool;
+        bool operator()(OrderPool::Handle a, OrderPool::Handle b) const {
+            double priceA = pool.get(a).price;
+            double priceB = pool.get(b).price;
+            if (priceA != priceB)
+                return priceA < priceB;
+            return pool.sequence(a) > pool.sequence(b);
+        }
+    };
+
+    struct SellPriority {
+        const OrderPool& pool;
+        bool operator()(OrderPool::Handle a, OrderPool::Handle b) const {
+            double priceA = pool.get(a).price;
+            double priceB = pool.get(b).price;
+            if (priceA != priceB)
+                return priceA > priceB;
+            return pool.sequence(a) > pool.sequence(b);
+        }
+    };
+
+    OrderPool orders;
+    std::vector<OrderPool::Handle> buyOrders;
+    std::vector<OrderPool::Handle> sellOrders;
+    uint64_t nextSequence;
 };
 
 class Trader {
@@ -78,7 +168,9 @@ public:
 
         int orderId = ++orderIdCounter;
         Order order(orderId, type, price, quantity);
-        orderBook.addOrder(order);
+        if (!orderBook.addOrder(order)) {
+            return;
+        }
 
         
         if (type == Order::Type::BUY) {
@@ -114,9 +206,11 @@ private:
     std::default_random_engine randomEngine;
 };
 
-int main() {
+int main(int argc, char* argv[]) {
+    uint32_t poolCapacity = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1024;
+
     Market market;
-    OrderBook orderBook;
+    OrderBook orderBook(poolCapacity);
     Trader trader1(1, 10000.0); 
     Trader trader2(2, 5000.0);  
 
@@ -129,5 +223,9 @@ int main() {
     
     orderBook.matchOrders();
 
+    const OrderPool& pool = orderBook.pool();
+    std::cout << "Order pool: " << pool.inUse() << " of " << pool.capacity()
+              << " in use, high-water mark " << pool.highWaterMark() << std::endl;
+
     return 0;
 }
@@ -0,0 +1,103 @@
+#ifndef MARKET_DEPTH_H
+#define MARKET_DEPTH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Aggregated book depth as a snapshot plus a stream of level deltas. The book's thread publishes
+// every level change to a DepthDeltaRing; a reader takes a snapshot, notes its sequence and then
+// applies the deltas after it:
+//
+//     market_depth::DepthSnapshot snapshot = book.depthSnapshot(10);
+//     std::vector<market_depth::LevelDelta> deltas;
+//     if (!book.deltas().readSince(snapshot.sequence, deltas)) { /* lapped: snapshot again */ }
+namespace market_depth {
+
+struct DepthLevel {
+    double price;
+    double quantity;
+    size_t orderCount;
+};
+
+struct DepthSnapshot {
+    std::vector<DepthLevel> bids;
+    std::vector<DepthLevel> asks;
+    uint64_t sequence;
+};
+
+struct LevelDelta {
+    bool isBuy;
+    double price;
+    double quantity;
+    uint32_t orderCount;
+    uint64_t sequence;
+};
+
+class DepthDeltaRing {
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<bool> isBuy{false};
+        std::atomic<double> price{0};
+        std::atomic<double> quantity{0};
+        std::atomic<uint32_t> orderCount{0};
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+    std::atomic<uint64_t> published{0};
+
+public:
+    explicit DepthDeltaRing(size_t capacity = 4096) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots = std::vector<Slot>(size);
+        mask = size - 1;
+    }
+
+    void publish(bool isBuy, double price, double quantity, uint32_t orderCount) {
+        uint64_t sequence = published.load(std::memory_order_relaxed) + 1;
+        Slot& slot = slots[sequence & mask];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.isBuy.store(isBuy, std::memory_order_relaxed);
+        slot.price.store(price, std::memory_order_relaxed);
+        slot.quantity.store(quantity, std::memory_order_relaxed);
+        slot.orderCount.store(orderCount, std::memory_order_relaxed);
+        slot.sequence.store(sequence, std::memory_order_release);
+        published.store(sequence, std::memory_order_release);
+    }
+
+    uint64_t lastSequence() const {
+        return published.load(std::memory_order_acquire);
+    }
+
+    // Returns false when deltas after `afterSequence` have already been overwritten; the reader
+    // must then take a fresh snapshot.
+    bool readSince(uint64_t afterSequence, std::vector<LevelDelta>& out) const {
+        uint64_t last = lastSequence();
+        for (uint64_t sequence = afterSequence + 1; sequence <= last; ++sequence) {
+            const Slot& slot = slots[sequence & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+                return false;
+            }
+            LevelDelta delta{slot.isBuy.load(std::memory_order_relaxed), slot.price.load(std::memory_order_relaxed),
+                             slot.quantity.load(std::memory_order_relaxed), slot.orderCount.load(std::memory_order_relaxed),
+                             sequence};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                return false;
+            }
+            out.push_back(delta);
+        }
+        return true;
+    }
+};
+
+}  // namespace market_depth
+
+#endif
@@ -6,6 +6,11 @@
 #include <algorithm>
 #include <ctime>
 #include <cmath>
+#include <deque>
+#include <atomic>
+#include <cstdint>
+
+#include "market_depth.h"
 
 class Order {
 public:
@@ -28,93 +33,239 @@ public:
     }
 };
 
+struct PriceLevel {
+    std::deque<Order> orders;
+    double totalQuantity = 0;
+};
+
+struct AuctionResult {
+    bool crossed = false;
+    double price = 0;
+    double executableVolume = 0;
+    double buyVolume = 0;
+    double sellVolume = 0;
+    double imbalance = 0;
+};
+
 class OrderBook {
 private:
-    std::map<double, std::queue<Order>> buyOrders;
-    std::map<double, std::queue<Order>> sellOrders;
+    std::map<double, PriceLevel> buyOrders;
+    std::map<double, PriceLevel> sellOrders;
+    double lastTradePrice = 0;
+    market_depth::DepthDeltaRing depthDeltas;
 
 public:
     void addOrder(const Order& order) {
         if (order.side == "BUY") {
-            buyOrders[order.price].push(order);
+            PriceLevel& level = buyOrders[order.price];
+            level.orders.push_back(order);
+            level.totalQuantity += order.quantity;
+            publishLevel(true, order.price, level);
         } else if (order.side == "SELL") {
-            sellOrders[order.price].push(order);
+            PriceLevel& level = sellOrders[order.price];
+            level.orders.push_back(order);
+            level.totalQuantity += order.quantity;
+            publishLevel(false, order.price, level);
         }
     }
 
     void removeOrder(const std::string& orderId, const std::string& side) {
-        if (side == "BUY") {
-            for (auto& [price, queue] : buyOrders) {
-                if (!queue.empty() && queue.front().orderId == orderId) {
-                    queue.pop();
-                    break;
-                }
-            }
-        } else if (side == "SELL") {
-            for (auto& [price, queue] : sellOrders) {
-                if (!queue.empty() && queue.front().orderId == orderId) {
-                    queue.pop();
-                    break;
+        auto& levels = side == "BUY" ? buyOrders : sellOrders;
+        if (side != "BUY" && side != "SELL") {
+            return;
+        }
+        for (auto it = levels.begin(); it != levels.end(); ++it) {
+            PriceLevel& level = it->second;
+            if (!level.orders.empty() && level.orders.front().orderId == orderId) {
+                level.totalQuantity -= level.orders.front().quantity;
+                level.orders.pop_front();
+                publishLevel(side == "BUY", it->first, level);
+                if (level.orders.empty()) {
+                    levels.erase(it);
                 }
+                break;
             }
         }
     }
 
     void matchOrders() {
         while (!buyOrders.empty() && !sellOrders.empty()) {
-            auto buyIt = buyOrders.rbegin();
+            auto buyIt = std::prev(buyOrders.end());
             auto sellIt = sellOrders.begin();
 
             if (buyIt->first >= sellIt->first) {
                 double price = sellIt->first;
-                double quantity = std::min(buyIt->second.front().quantity, sellIt->second.front().quantity);
+                double quantity = std::min(buyIt->second.orders.front().quantity, sellIt->second.orders.front().quantity);
 
                 std::cout << "Match: " << quantity << " units at price " << price << std::endl;
 
-                buyIt->second.front().quantity -= quantity;
-                sellIt->second.front().quantity -= quantity;
+                fill(buyOrders, buyIt, quantity, true);
+                fill(sellOrders, sellIt, quantity, false);
+                lastTradePrice = price;
+            } else {
+                break;
+            }
+        }
+    }
 
-                if (buyIt->second.front().quantity == 0) {
-                    buyIt->second.pop();
-                    if (buyIt->second.empty()) {
-                        buyOrders.erase(buyIt->first);
-                    }
-                }
+    // Single pass over the aggregated levels: walking prices upward, supply at p is every sell
+    // priced <= p and demand is every buy priced >= p.
+    AuctionResult computeUncross() const {
+        AuctionResult best;
+        double totalBuy = 0;
+        for (const auto& [price, level] : buyOrders) {
+            totalBuy += level.totalQuantity;
+        }
 
-                if (sellIt->second.front().quantity == 0) {
-                    sellIt->second.pop();
-                    if (sellIt->second.empty()) {
-                        sellOrders.erase(sellIt->first);
-                    }
-                }
+        double buyBelow = 0;
+        double sellAtOrBelow = 0;
+        auto buyIt = buyOrders.begin();
+        auto sellIt = sellOrders.begin();
+        while (buyIt != buyOrders.end() || sellIt != sellOrders.end()) {
+            double price;
+            if (sellIt == sellOrders.end() || (buyIt != buyOrders.end() && buyIt->first < sellIt->first)) {
+                price = buyIt->first;
             } else {
+                price = sellIt->first;
+            }
+            if (sellIt != sellOrders.end() && sellIt->first == price) {
+                sellAtOrBelow += sellIt->second.totalQuantity;
+                ++sellIt;
+            }
+
+            double demand = totalBuy - buyBelow;
+            double executable = std::min(demand, sellAtOrBelow);
+            if (executable > 0 && isBetterUncross(executable, demand - sellAtOrBelow, price, best)) {
+                best.crossed = true;
+                best.price = price;
+                best.executableVolume = executable;
+                best.buyVolume = demand;
+                best.sellVolume = sellAtOrBelow;
+                best.imbalance = demand - sellAtOrBelow;
+            }
+
+            if (buyIt != buyOrders.end() && buyIt->first == price) {
+                buyBelow += buyIt->second.totalQuantity;
+                ++buyIt;
+            }
+        }
+        return best;
+    }
+
+    AuctionResult uncross() {
+        AuctionResult result = computeUncross();
+        if (!result.crossed) {
+            return result;
+        }
+
+        double remaining = result.executableVolume;
+        while (remaining > 0 && !buyOrders.empty() && !sellOrders.empty()) {
+            auto buyIt = std::prev(buyOrders.end());
+            auto sellIt = sellOrders.begin();
+            if (buyIt->first < result.price || sellIt->first > result.price) {
                 break;
             }
+            double quantity = std::min({buyIt->second.orders.front().quantity, sellIt->second.orders.front().quantity, remaining});
+            fill(buyOrders, buyIt, quantity, true);
+            fill(sellOrders, sellIt, quantity, false);
+            remaining -= quantity;
         }
+        lastTradePrice = result.price;
+        return result;
+    }
+
+    bool hasBidAndAsk() const {
+        return !buyOrders.empty() && !sellOrders.empty();
+    }
+
+    double bestBid() const {
+        return buyOrders.rbegin()->first;
+    }
+
+    double bestAsk() const {
+        return sellOrders.begin()->first;
+    }
+
+    market_depth::DepthSnapshot depthSnapshot(size_t levels) const {
+        market_depth::DepthSnapshot snapshot;
+        for (auto it = buyOrders.rbegin(); it != buyOrders.rend() && snapshot.bids.size() < levels; ++it) {
+            snapshot.bids.push_back({it->first, it->second.totalQuantity, it->second.orders.size()});
+        }
+        for (auto it = sellOrders.begin(); it != sellOrders.end() && snapshot.asks.size() < levels; ++it) {
+            snapshot.asks.push_back({it->first, it->second.totalQuantity, it->second.orders.size()});
+        }
+        snapshot.sequence = depthDeltas.lastSequence();
+        return snapshot;
+    }
+
+    const market_depth::DepthDeltaRing& deltas() const {
+        return depthDeltas;
     }
 
     void printOrderBook() const {
         std::cout << "\nOrder Book:" << std::endl;
         std::cout << "Buy Orders:" << std::endl;
-        for (auto& [price, queue] : buyOrders) {
-            std::cout << "Price: " << price << ", Quantity: " << queue.size() << std::endl;
+        for (auto& [price, level] : buyOrders) {
+            std::cout << "Price: " << price << ", Quantity: " << level.totalQuantity
+                      << ", Orders: " << level.orders.size() << std::endl;
         }
 
         std::cout << "Sell Orders:" << std::endl;
-        for (auto& [price, queue] : sellOrders) {
-            std::cout << "Price: " << price << ", Quantity: " << queue.size() << std::endl;
+        for (auto& [price, level] : sellOrders) {
+            std::cout << "Price: " << price << ", Quantity: " << level.totalQuantity
+                      << ", Orders: " << level.orders.size() << std::endl;
+        }
+    }
+
+private:
+    void publishLevel(bool isBuy, double price, const PriceLevel& level) {
+        depthDeltas.publish(isBuy, price, level.totalQuantity, static_cast<uint32_t>(level.orders.size()));
+    }
+
+    void fill(std::map<double, PriceLevel>& levels, std::map<double, PriceLevel>::iterator it, double quantity, bool isBuy) {
+        PriceLevel& level = it->second;
+        level.orders.front().quantity -= quantity;
+        level.totalQuantity -= quantity;
+        if (level.orders.front().quantity == 0) {
+            level.orders.pop_front();
+        }
+        publishLevel(isBuy, it->first, level);
+        if (level.orders.empty()) {
+            levels.erase(it);
         }
     }
+
+    // Maximum volume first, then the smallest absolute imbalance, then the side of the market
+    // pressure (higher price when buyers are left over, lower when sellers are), then closeness
+    // to the last trade price.
+    bool isBetterUncross(double executable, double imbalance, double price, const AuctionResult& best) const {
+        if (!best.crossed || executable != best.executableVolume) {
+            return !best.crossed || executable > best.executableVolume;
+        }
+        if (std::fabs(imbalance) != std::fabs(best.imbalance)) {
+            return std::fabs(imbalance) < std::fabs(best.imbalance);
+        }
+        if (imbalance > 0) {
+            return price > best.price;
+        }
+        if (imbalance < 0) {
+            return price < best.price;
+        }
+        return lastTradePrice > 0 && std::fabs(price - lastTradePrice) < std::fabs(best.price - lastTradePrice);
+    }
 };
 
 class Market {
 private:
     OrderBook orderBook;
+    bool auctionMode = false;
 
 public:
     void placeOrder(const Order& order) {
         orderBook.addOrder(order);
-        orderBook.matchOrders();
+        if (!auctionMode) {
+            orderBook.matchOrders();
+        }
     }
 
     void cancelOrder(const std::string& orderId, const std::string& side) {
@@ -125,13 +276,48 @@ public:
         orderBook.printOrderBook();
     }
 
-    void marketSpread() const {
-        if (!orderBook.buyOrders.empty() && !orderBook.sellOrders.empty()) {
-            auto bestBid = orderBook.buyOrders.begin();
-            auto bestAsk = orderBook.sellOrders.begin();
+    market_depth::DepthSnapshot depth(size_t levels) const {
+        return orderBook.depthSnapshot(levels);
+    }
 
-            double bid = bestBid->first;
-            double ask = bestAsk->first;
+    const market_depth::DepthDeltaRing& depthDeltas() const {
+        return orderBook.deltas();
+    }
+
+    void beginAuction() {
+        auctionMode = true;
+    }
+
+    AuctionResult indicativeAuction() const {
+        return orderBook.computeUncross();
+    }
+
+    AuctionResult uncrossAuction() {
+        AuctionResult result = orderBook.uncross();
+        auctionMode = false;
+        if (result.crossed) {
+            std::cout << "Auction uncrossed: " << result.executableVolume << " units at price " << result.price
+                      << ", imbalance " << result.imbalance << std::endl;
+        } else {
+            std::cout << "Auction closed without a cross" << std::endl;
+        }
+        return result;
+    }
+
+    void printIndicativeAuction() const {
+        AuctionResult result = orderBook.computeUncross();
+        if (result.crossed) {
+            std::cout << "Indicative Price: " << result.price << ", Matched Volume: " << result.executableVolume
+                      << ", Imbalance: " << result.imbalance << std::endl;
+        } else {
+            std::cout << "No indicative price available" << std::endl;
+        }
+    }
+
+    void marketSpread() const {
+        if (orderBook.hasBidAndAsk()) {
+            double bid = orderBook.bestBid();
+            double ask = orderBook.bestAsk();
 
             std::cout << "Best Bid: " << bid << ", Best Ask: " << ask
                       << ", Spread: " << (ask - bid) << std::endl;
@@ -148,6 +334,19 @@ public:
         return currentPrice * (1 + change);
     }
 
+    static void simulateOpeningAuction(Market& market, const std::string& symbol) {
+        market.beginAuction();
+        for (int i = 0; i < 20; ++i) {
+            double price = 99.0 + (rand() % 21) / 10.0;
+            double quantity = (rand() % 10) + 1;
+            std::string side = (i % 2 == 0) ? "BUY" : "SELL";
+            market.placeOrder(Order("AUC" + std::to_string(i), symbol, price, quantity, side));
+        }
+        market.printIndicativeAuction();
+        market.uncrossAuction();
+        market.marketSpread();
+    }
+
     static void simulateMarket(Market& market, const std::string& symbol) {
         for (int i = 0; i < 50; ++i) {
             double price = 100.0; 
@@ -176,6 +375,7 @@ int main() {
     srand(time(0));
 
     Market market;
+    MarketData::simulateOpeningAuction(market, "AAPL");
     MarketData::simulateMarket(market, "AAPL");
 
     return 0;
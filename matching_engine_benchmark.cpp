@@ -0,0 +1,501 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <list>
+#include <queue>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fstream>
+#include <ctime>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "order_book.h"
+#include "latency_clock.h"
+#include "market_depth.h"
+
+// Every engine is a standalone program, so each one is pulled in under its own namespace with its
+// main() renamed. The standard headers above are already included, so their guards keep them
+// from being re-opened inside the namespaces.
+#define main simulator_main
+namespace heap_book {
+#include "main.cpp"
+}
+namespace broker_exchange {
+#include "broker_and _exchange_simulation.cpp"
+}
+namespace cross_border {
+#include "cross_border_trading.cpp"
+}
+namespace microstructure {
+#include "market_microstructure_analysis.cpp"
+}
+namespace order_management {
+#include "order_management_system.cpp"
+}
+namespace optimised {
+#include "performance_optimisation.cpp"
+}
+namespace multicore {
+#include "parallel_and_multicore_processing.cpp"
+}
+namespace caching {
+#include "order_and_trade_data_caching.cpp"
+}
+#undef main
+
+struct BenchmarkConfig {
+    uint64_t seed = 42;
+    size_t operations = 200000;
+    size_t prefillDepth = 2000;
+    double cancelRatio = 0.45;
+    double marketRatio = 0.05;
+    double midPrice = 100.0;
+    double tickSize = 0.01;
+    double priceSigmaTicks = 20.0;
+};
+
+enum class OpType : uint8_t { ADD, CANCEL, MARKET };
+
+struct FlowOp {
+    OpType type;
+    bool isBuy;
+    double price;
+    long quantity;
+    uint64_t target;
+};
+
+// The same seeded flow is replayed against every engine. Limit prices are drawn from a normal
+// distribution in ticks around the mid so a fraction of them cross; cancels pick a previously
+// added order at random whether or not it has since traded.
+std::vector<FlowOp> generateFlow(const BenchmarkConfig& config) {
+    std::mt19937_64 rng(config.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> offset(0.0, config.priceSigmaTicks);
+    std::uniform_int_distribution<long> quantity(1, 100);
+
+    std::vector<FlowOp> flow;
+    flow.reserve(config.prefillDepth + config.operations);
+    std::vector<uint64_t> added;
+    uint64_t nextAdd = 0;
+
+    auto addLimit = [&](bool passiveOnly) {
+        bool isBuy = unit(rng) < 0.5;
+        double ticks = std::fabs(offset(rng)) + 1;
+        if (!passiveOnly && unit(rng) < 0.2) {
+            ticks = -ticks / 4;
+        }
+        double price = config.midPrice + (isBuy ? -1 : 1) * std::round(ticks) * config.tickSize;
+        flow.push_back({OpType::ADD, isBuy, price, quantity(rng), nextAdd});
+        added.push_back(nextAdd++);
+    };
+
+    for (size_t i = 0; i < config.prefillDepth; ++i) {
+        addLimit(true);
+    }
+    for (size_t i = 0; i < config.operations; ++i) {
+        double draw = unit(rng);
+        if (draw < config.cancelRatio && !added.empty()) {
+            size_t pick = static_cast<size_t>(unit(rng) * added.size()) % added.size();
+            flow.push_back({OpType::CANCEL, false, 0, 0, added[pick]});
+            added[pick] = added.back();
+            added.pop_back();
+        } else if (draw < config.cancelRatio + config.marketRatio) {
+            flow.push_back({OpType::MARKET, unit(rng) < 0.5, 0, quantity(rng), 0});
+        } else {
+            addLimit(false);
+        }
+    }
+    return flow;
+}
+
+class EngineAdapter {
+public:
+    virtual ~EngineAdapter() {}
+    virtual std::string name() const = 0;
+    virtual bool supportsCancel() const { return true; }
+    virtual bool supportsMarket() const { return true; }
+    virtual void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) = 0;
+    virtual void cancel(uint64_t flowId) = 0;
+    virtual void market(bool isBuy, long quantity) = 0;
+};
+
+// Engines that number orders themselves (1, 2, 3, ...) are driven through this mapping.
+class SequentialIds {
+public:
+    long assign(uint64_t flowId) {
+        if (ids.size() <= flowId) {
+            ids.resize(flowId + 1, 0);
+        }
+        ids[flowId] = ++next;
+        return ids[flowId];
+    }
+
+    long skip() {
+        return ++next;
+    }
+
+    long lookup(uint64_t flowId) const {
+        return flowId < ids.size() ? ids[flowId] : 0;
+    }
+
+private:
+    std::vector<long> ids;
+    long next = 0;
+};
+
+class HeapBookAdapter : public EngineAdapter {
+public:
+    HeapBookAdapter(size_t capacity) : book(static_cast<uint32_t>(capacity)) {}
+    std::string name() const override { return "main.cpp heap+pool"; }
+    bool supportsCancel() const override { return false; }
+    bool supportsMarket() const override { return false; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        using heap_book::Order;
+        book.addOrder(Order(static_cast<int>(flowId), isBuy ? Order::Type::BUY : Order::Type::SELL, price, static_cast<int>(quantity)));
+        book.matchOrders();
+    }
+    void cancel(uint64_t) override {}
+    void market(bool, long) override {}
+
+private:
+    heap_book::OrderBook book;
+};
+
+class BrokerAdapter : public EngineAdapter {
+public:
+    BrokerAdapter(bool useLadder, const BenchmarkConfig& config, size_t capacity) : ladder(useLadder) {
+        exchange.setVerbose(false);
+        if (useLadder) {
+            exchange.enableTickLadder("BENCH", config.tickSize, config.midPrice, 1 << 16, capacity);
+        }
+    }
+    std::string name() const override { return ladder ? "broker tick ladder" : "broker map+list"; }
+    bool supportsMarket() const override { return false; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        using broker_exchange::Order;
+        long id = exchange.placeOrder(Order("BENCH", price, static_cast<int>(quantity),
+                                            isBuy ? Order::Type::BUY : Order::Type::SELL, "bench", ""));
+        if (ids.size() <= flowId) {
+            ids.resize(flowId + 1, 0);
+        }
+        ids[flowId] = id;
+    }
+    void cancel(uint64_t flowId) override {
+        exchange.cancelOrder(flowId < ids.size() ? ids[flowId] : 0L);
+    }
+    void market(bool, long) override {}
+
+private:
+    bool ladder;
+    broker_exchange::Exchange exchange;
+    std::vector<long> ids;
+};
+
+// The shared header-only book, specialised per build.
+template <typename Book>
+class TemplateBookAdapter : public EngineAdapter {
+public:
+    TemplateBookAdapter(const std::string& label, const BenchmarkConfig& config)
+        : label(label), book(config.midPrice - (1 << 15) * config.tickSize, 1 << 16) {}
+    std::string name() const override { return label; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        book.add(flowId + 1, isBuy ? matching::Side::BUY : matching::Side::SELL, price, quantity);
+    }
+    void cancel(uint64_t flowId) override {
+        book.cancel(flowId + 1);
+    }
+    void market(bool isBuy, long quantity) override {
+        book.market(0, isBuy ? matching::Side::BUY : matching::Side::SELL, quantity);
+    }
+
+private:
+    std::string label;
+    Book book;
+};
+
+// Drives the ladder book directly (no Exchange routing) so allocation policies can be compared.
+template <typename AllocationPolicy>
+class LadderAllocationAdapter : public EngineAdapter {
+public:
+    LadderAllocationAdapter(const std::string& label, const BenchmarkConfig& config, size_t capacity)
+        : label(label), book("BENCH", config.tickSize, config.midPrice, 1 << 16, capacity) {
+        book.echoTrades = false;
+    }
+    std::string name() const override { return label; }
+    bool supportsMarket() const override { return false; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        using broker_exchange::Order;
+        book.addOrder(Order("BENCH", price, static_cast<int>(quantity), isBuy ? Order::Type::BUY : Order::Type::SELL,
+                            "bench", "", static_cast<long>(flowId + 1)));
+        book.matchOrders();
+        book.closedOrderIds.clear();
+    }
+    void cancel(uint64_t flowId) override {
+        book.cancelOrder(static_cast<long>(flowId + 1));
+    }
+    void market(bool, long) override {}
+
+private:
+    std::string label;
+    broker_exchange::BasicPriceLadderBook<AllocationPolicy> book;
+};
+
+class CrossBorderAdapter : public EngineAdapter {
+public:
+    std::string name() const override { return "cross_border map+deque"; }
+    bool supportsMarket() const override { return false; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        sides[flowId] = isBuy;
+        book.addOrder(cross_border::Order(std::to_string(flowId), "BENCH", price, static_cast<double>(quantity),
+                                          isBuy ? "BUY" : "SELL", "NYSE"));
+    }
+    void cancel(uint64_t flowId) override {
+        book.removeOrder(std::to_string(flowId), sides[flowId] ? "BUY" : "SELL");
+    }
+    void market(bool, long) override {}
+
+private:
+    cross_border::OrderBook book;
+    std::unordered_map<uint64_t, bool> sides;
+};
+
+class MicrostructureAdapter : public EngineAdapter {
+public:
+    std::string name() const override { return "microstructure map+deque"; }
+    bool supportsMarket() const override { return false; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        sides[flowId] = isBuy;
+        market_.placeOrder(microstructure::Order(std::to_string(flowId), "BENCH", price, static_cast<double>(quantity),
+                                                 isBuy ? "BUY" : "SELL"));
+    }
+    void cancel(uint64_t flowId) override {
+        market_.cancelOrder(std::to_string(flowId), sides[flowId] ? "BUY" : "SELL");
+    }
+    void market(bool, long) override {}
+
+private:
+    microstructure::Market market_;
+    std::unordered_map<uint64_t, bool> sides;
+};
+
+// The order-management books have no order side: limits rest and market orders take from them.
+template <typename Oms>
+class OneSidedOmsAdapter : public EngineAdapter {
+public:
+    template <typename... Args>
+    OneSidedOmsAdapter(const std::string& label, Args&&... args) : label(label), oms(std::forward<Args>(args)...) {}
+    std::string name() const override { return label; }
+
+    void addLimit(uint64_t flowId, bool, double price, long quantity) override {
+        ids.assign(flowId);
+        oms.placeLimitOrder(price, quantity);
+        oms.processOrders();
+    }
+    void cancel(uint64_t flowId) override {
+        oms.cancelOrder(ids.lookup(flowId));
+    }
+    void market(bool, long quantity) override {
+        ids.skip();
+        oms.placeMarketOrder(quantity);
+        oms.processOrders();
+    }
+
+private:
+    std::string label;
+    Oms oms;
+    SequentialIds ids;
+};
+
+class OptimisedAdapter : public EngineAdapter {
+public:
+    std::string name() const override { return "performance_optimisation"; }
+
+    void addLimit(uint64_t flowId, bool isBuy, double price, long quantity) override {
+        ids.assign(flowId);
+        oms.placeLimitOrder(price, quantity, isBuy);
+    }
+    void cancel(uint64_t flowId) override {
+        oms.cancelOrder(ids.lookup(flowId));
+    }
+    void market(bool isBuy, long quantity) override {
+        ids.skip();
+        oms.placeMarketOrder(quantity, isBuy);
+    }
+
+private:
+    optimised::OrderManagementSystem oms;
+    SequentialIds ids;
+};
+
+struct EngineResult {
+    std::string name;
+    uint64_t operations = 0;
+    uint64_t skipped = 0;
+    double seconds = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+    long peakRssKb = 0;
+};
+
+long peakRssKb() {
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+EngineResult runEngine(EngineAdapter& engine, const std::vector<FlowOp>& flow) {
+    timing::LatencyHistogram histogram;
+    EngineResult result;
+    result.name = engine.name();
+
+    // Several engines print every trade; their output is discarded but its formatting cost is
+    // part of what they do, so it stays inside the timed region.
+    std::ostringstream sink;
+    std::streambuf* console = std::cout.rdbuf(sink.rdbuf());
+
+    timing::NanoClock::calibrate();
+    auto start = std::chrono::steady_clock::now();
+    for (const FlowOp& op : flow) {
+        if ((op.type == OpType::CANCEL && !engine.supportsCancel()) || (op.type == OpType::MARKET && !engine.supportsMarket())) {
+            ++result.skipped;
+            continue;
+        }
+        uint64_t before = timing::NanoClock::now();
+        switch (op.type) {
+        case OpType::ADD:
+            engine.addLimit(op.target, op.isBuy, op.price, op.quantity);
+            break;
+        case OpType::CANCEL:
+            engine.cancel(op.target);
+            break;
+        case OpType::MARKET:
+            engine.market(op.isBuy, op.quantity);
+            break;
+        }
+        histogram.record(timing::NanoClock::now() - before);
+        if (sink.tellp() > (1 << 20)) {
+            sink.str("");
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(console);
+
+    result.operations = histogram.count();
+    result.p50 = histogram.percentile(0.50);
+    result.p99 = histogram.percentile(0.99);
+    result.p999 = histogram.percentile(0.999);
+    result.max = histogram.max();
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+std::unique_ptr<EngineAdapter> makeEngine(size_t index, const BenchmarkConfig& config, size_t capacity) {
+    switch (index) {
+    case 0: return std::make_unique<HeapBookAdapter>(capacity);
+    case 1: return std::make_unique<BrokerAdapter>(false, config, capacity);
+    case 2: return std::make_unique<BrokerAdapter>(true, config, capacity);
+    case 3: return std::make_unique<CrossBorderAdapter>();
+    case 4: return std::make_unique<MicrostructureAdapter>();
+    case 5: return std::make_unique<OneSidedOmsAdapter<order_management::OrderManagementSystem>>("order_management_system");
+    case 6: return std::make_unique<OptimisedAdapter>();
+    case 7: return std::make_unique<OneSidedOmsAdapter<multicore::OrderManagementSystem>>("parallel_and_multicore");
+    case 8: return std::make_unique<OneSidedOmsAdapter<caching::OrderManagementSystem>>("order_and_trade_caching", capacity);
+    case 9: return std::make_unique<LadderAllocationAdapter<broker_exchange::FifoAllocation>>("ladder fifo", config, capacity);
+    case 10: return std::make_unique<LadderAllocationAdapter<broker_exchange::ProRataAllocation<2>>>("ladder pro-rata", config, capacity);
+    case 11: return std::make_unique<LadderAllocationAdapter<broker_exchange::TopOrderProRataAllocation<10, 2>>>("ladder top+pro-rata", config, capacity);
+    case 12: return std::make_unique<TemplateBookAdapter<matching::OrderBook<matching::TickPrice<100>, matching::MapLevels>>>("order_book.h tick map", config);
+    case 13: return std::make_unique<TemplateBookAdapter<matching::OrderBook<matching::TickPrice<100>, matching::LadderLevels>>>("order_book.h tick ladder", config);
+    default: return nullptr;
+    }
+}
+
+const size_t ENGINE_COUNT = 14;
+
+void printResult(const EngineResult& result) {
+    std::printf("%-28s %10llu %12.0f %9llu %9llu %9llu %11llu %10ld %9llu\n", result.name.c_str(),
+                static_cast<unsigned long long>(result.operations),
+                result.seconds > 0 ? result.operations / result.seconds : 0.0,
+                static_cast<unsigned long long>(result.p50), static_cast<unsigned long long>(result.p99),
+                static_cast<unsigned long long>(result.p999), static_cast<unsigned long long>(result.max),
+                result.peakRssKb, static_cast<unsigned long long>(result.skipped));
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    if (argc > 1) config.operations = std::strtoull(argv[1], nullptr, 10);
+    if (argc > 2) config.seed = std::strtoull(argv[2], nullptr, 10);
+    if (argc > 3) config.prefillDepth = std::strtoull(argv[3], nullptr, 10);
+    if (argc > 4) config.cancelRatio = std::atof(argv[4]);
+    if (argc > 5) config.marketRatio = std::atof(argv[5]);
+    if (argc > 6) config.priceSigmaTicks = std::atof(argv[6]);
+    std::string only = argc > 7 ? argv[7] : "";
+
+    std::vector<FlowOp> flow = generateFlow(config);
+    size_t capacity = flow.size() + 1;
+
+    std::printf("seed %llu, %zu operations after %zu prefill orders, cancel %.2f, market %.2f, sigma %.1f ticks\n",
+                static_cast<unsigned long long>(config.seed), config.operations, config.prefillDepth,
+                config.cancelRatio, config.marketRatio, config.priceSigmaTicks);
+    std::printf("%-28s %10s %12s %9s %9s %9s %11s %10s %9s\n", "engine", "ops", "ops/s", "p50 ns", "p99 ns",
+                "p99.9 ns", "max ns", "rss KB", "skipped");
+    std::fflush(stdout);
+
+    for (size_t i = 0; i < ENGINE_COUNT; ++i) {
+        std::unique_ptr<EngineAdapter> probe = makeEngine(i, config, 1);
+        if (!only.empty() && probe->name().find(only) == std::string::npos) {
+            continue;
+        }
+        probe.reset();
+#ifndef _WIN32
+        // Each engine runs in its own process so peak RSS is attributable to it alone.
+        pid_t child = fork();
+        if (child == 0) {
+            std::unique_ptr<EngineAdapter> engine = makeEngine(i, config, capacity);
+            printResult(runEngine(*engine, flow));
+            std::fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+#else
+        std::unique_ptr<EngineAdapter> engine = makeEngine(i, config, capacity);
+        printResult(runEngine(*engine, flow));
+#endif
+    }
+    return 0;
+}
@@ -2,11 +2,14 @@
 #include <vector>
 #include <queue>
 #include <unordered_map>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <atomic>
 #include <chrono>
 #include <algorithm>
+#include <condition_variable>
+#include <cstddef>
 
 struct Order {
     long orderId;
@@ -16,6 +19,14 @@ struct Order {
     bool isFilled;
 };
 
+// What the ingress ring carries. A cancel travels the same ring as the orders, so it is applied
+// by the matching thread after the order it cancels and never races the book.
+struct OrderCommand {
+    enum class Kind { PLACE, CANCEL };
+    Kind kind;
+    Order order;
+};
+
 struct Trade {
     long buyOrderId;
     long sellOrderId;
@@ -45,6 +56,22 @@ public:
         return false;
     }
 
+    void addBatchToCache(const std::vector<Order>& orders, const std::vector<Trade>& trades) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (const Order& order : orders) {
+            if (orderCache.size() >= maxSize && orderCache.find(order.orderId) == orderCache.end()) {
+                orderCache.erase(orderCache.begin());
+            }
+            orderCache[order.orderId] = order;
+        }
+        for (const Trade& trade : trades) {
+            if (tradeCache.size() >= maxSize) {
+                tradeCache.erase(tradeCache.begin());
+            }
+            tradeCache.push_back(trade);
+        }
+    }
+
     void addTradeToCache(const Trade& trade) {
         std::lock_guard<std::mutex> lock(cacheMutex);
         if (tradeCache.size() >= maxSize) {
@@ -81,41 +108,40 @@ public:
 
     void addOrder(Order order) {
         std::lock_guard<std::mutex> lock(orderBookMutex);
-        if (order.isMarketOrder) {
-            marketOrders.push(order);
-        } else {
-            limitOrders.push_back(order);
-            std::sort(limitOrders.begin(), limitOrders.end(), [](const Order& a, const Order& b) {
-                return a.price < b.price;
-            });
-        }
+        insertOrder(order);
         cache.addOrderToCache(order);
     }
 
-    void cancelOrder(long orderId) {
-        std::lock_guard<std::mutex> lock(orderBookMutex);
-        for (auto& order : limitOrders) {
-            if (order.orderId == orderId && !order.isFilled) {
-                order.isFilled = true;
-                break;
+    // Applies a drained ingress batch on the owning thread in ring order: the book lock is taken
+    // once and uncontended, and the cache sees one locked update for the whole batch.
+    void applyBatch(const std::vector<OrderCommand>& batch) {
+        {
+            std::lock_guard<std::mutex> lock(orderBookMutex);
+            for (const OrderCommand& command : batch) {
+                if (command.kind == OrderCommand::Kind::CANCEL) {
+                    cancelLocked(command.order.orderId);
+                } else {
+                    insertOrder(command.order);
+                    placedOrders.push_back(command.order);
+                }
             }
+            batchTrades = &pendingTrades;
+            matchLocked();
+            batchTrades = nullptr;
         }
+        cache.addBatchToCache(placedOrders, pendingTrades);
+        placedOrders.clear();
+        pendingTrades.clear();
     }
 
-    void processOrders() {
+    void cancelOrder(long orderId) {
         std::lock_guard<std::mutex> lock(orderBookMutex);
-        while (!marketOrders.empty() && !limitOrders.empty()) {
-            Order marketOrder = marketOrders.front();
-            Order limitOrder = limitOrders.front();
+        cancelLocked(orderId);
+    }
 
-            if (marketOrder.price >= limitOrder.price) {
-                executeTrade(marketOrder, limitOrder);
-                marketOrders.pop();
-                limitOrders.erase(limitOrders.begin());
-            } else {
-                break;
-            }
-        }
+    void processOrders() {
+        std::lock_guard<std::mutex> lock(orderBookMutex);
+        matchLocked();
     }
 
     void printOrderBook() {
@@ -133,43 +159,287 @@ private:
     std::mutex orderBookMutex;
     long orderIdCounter;
     Cache& cache;
+    std::vector<Order> placedOrders;
+    std::vector<Trade> pendingTrades;
+    std::vector<Trade>* batchTrades = nullptr;
+
+    void cancelLocked(long orderId) {
+        for (auto& order : limitOrders) {
+            if (order.orderId == orderId && !order.isFilled) {
+                order.isFilled = true;
+                break;
+            }
+        }
+    }
+
+    void insertOrder(const Order& order) {
+        if (order.isMarketOrder) {
+            marketOrders.push(order);
+        } else {
+            auto position = std::upper_bound(limitOrders.begin(), limitOrders.end(), order.price,
+                [](double price, const Order& resting) { return price < resting.price; });
+            limitOrders.insert(position, order);
+        }
+    }
+
+    void matchLocked() {
+        while (!marketOrders.empty() && !limitOrders.empty()) {
+            Order& marketOrder = marketOrders.front();
+            Order& limitOrder = limitOrders.front();
+
+            if (limitOrder.isFilled) {
+                limitOrders.erase(limitOrders.begin());
+                continue;
+            }
+
+            if (marketOrder.isMarketOrder || marketOrder.price >= limitOrder.price) {
+                executeTrade(marketOrder, limitOrder);
+                if (limitOrder.quantity == 0) {
+                    limitOrders.erase(limitOrders.begin());
+                }
+                if (marketOrder.quantity == 0) {
+                    marketOrders.pop();
+                }
+            } else {
+                break;
+            }
+        }
+    }
 
     void executeTrade(Order& buyOrder, Order& sellOrder) {
         long tradedQuantity = std::min(buyOrder.quantity, sellOrder.quantity);
         buyOrder.quantity -= tradedQuantity;
         sellOrder.quantity -= tradedQuantity;
         Trade trade{buyOrder.orderId, sellOrder.orderId, sellOrder.price, tradedQuantity};
-        cache.addTradeToCache(trade);
+        if (batchTrades) {
+            batchTrades->push_back(trade);
+        } else {
+            cache.addTradeToCache(trade);
+        }
         std::cout << "Trade Executed: " << tradedQuantity << " units at price " << sellOrder.price << std::endl;
     }
 };
 
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : head(0), tail(0), cachedHead(0), cachedTail(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(const T& item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (currentTail - cachedHead > mask) {
+                return false;
+            }
+        }
+        slots[currentTail & mask] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t popBatch(std::vector<T>& out, size_t maxItems) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (cachedTail == currentHead) {
+            cachedTail = tail.load(std::memory_order_acquire);
+        }
+        size_t available = std::min(cachedTail - currentHead, maxItems);
+        for (size_t i = 0; i < available; ++i) {
+            out.push_back(slots[(currentHead + i) & mask]);
+        }
+        head.store(currentHead + available, std::memory_order_release);
+        return available;
+    }
+
+    size_t depth() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) size_t cachedHead;   // producer-side copy of head
+    alignas(64) size_t cachedTail;   // consumer-side copy of tail
+};
+
+class OrderIngress {
+public:
+    enum class FullPolicy { BLOCK, SPIN, TRY };
+
+    OrderIngress(OrderBook& orderBook, size_t capacity, size_t batchSize)
+        : orderBook(orderBook), ring(capacity), batchSize(batchSize), stopFlag(false), producerWaiting(false),
+          consumerParked(false), peakDepth(0) {
+        batch.reserve(batchSize);
+    }
+
+    ~OrderIngress() {
+        stop();
+    }
+
+    void start() {
+        matchingThread = std::thread(&OrderIngress::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(workMutex);
+            stopFlag = true;
+        }
+        workAvailable.notify_one();
+        if (matchingThread.joinable()) {
+            matchingThread.join();
+        }
+    }
+
+    // Single producer: every submit, including cancels, must come from the same thread.
+    bool submit(const OrderCommand& command, FullPolicy policy) {
+        while (!ring.tryPush(command)) {
+            if (policy == FullPolicy::TRY) {
+                return false;
+            }
+            if (policy == FullPolicy::BLOCK) {
+                std::unique_lock<std::mutex> lock(spaceMutex);
+                producerWaiting = true;
+                spaceAvailable.wait_for(lock, std::chrono::milliseconds(1), [this] { return ring.depth() < ring.capacity(); });
+                producerWaiting = false;
+            }
+        }
+        size_t depth = ring.depth();
+        if (depth > peakDepth.load(std::memory_order_relaxed)) {
+            peakDepth.store(depth, std::memory_order_relaxed);
+        }
+        // Pairs with the fence in park(): either the consumer sees the new tail or we see it parked.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumerParked.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(workMutex);
+            workAvailable.notify_one();
+        }
+        return true;
+    }
+
+    size_t depth() const {
+        return ring.depth();
+    }
+
+    size_t maxDepth() const {
+        return peakDepth.load(std::memory_order_relaxed);
+    }
+
+private:
+    OrderBook& orderBook;
+    // Empty polls the consumer yields through before it parks on workAvailable.
+    static const int IDLE_SPINS = 64;
+
+    SpscRing<OrderCommand> ring;
+    size_t batchSize;
+    std::vector<OrderCommand> batch;
+    std::thread matchingThread;
+    std::atomic<bool> stopFlag;
+    std::atomic<bool> producerWaiting;
+    std::atomic<bool> consumerParked;
+    std::atomic<size_t> peakDepth;
+    std::mutex spaceMutex;
+    std::condition_variable spaceAvailable;
+    std::mutex workMutex;
+    std::condition_variable workAvailable;
+
+    void park() {
+        std::unique_lock<std::mutex> lock(workMutex);
+        consumerParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        workAvailable.wait(lock, [this] { return stopFlag || ring.depth() > 0; });
+        consumerParked.store(false, std::memory_order_relaxed);
+    }
+
+    void run() {
+        int idlePolls = 0;
+        while (true) {
+            if (ring.popBatch(batch, batchSize) == 0) {
+                if (stopFlag) {
+                    return;
+                }
+                if (++idlePolls < IDLE_SPINS) {
+                    std::this_thread::yield();
+                } else {
+                    park();
+                    idlePolls = 0;
+                }
+                continue;
+            }
+            idlePolls = 0;
+            orderBook.applyBatch(batch);
+            batch.clear();
+            if (producerWaiting) {
+                std::lock_guard<std::mutex> lock(spaceMutex);
+                spaceAvailable.notify_one();
+            }
+        }
+    }
+};
+
 class OrderManagementSystem {
 public:
+    using FullPolicy = OrderIngress::FullPolicy;
+
     OrderManagementSystem(size_t cacheSize) : nextOrderId(1), cache(cacheSize), orderBook(cache) {}
 
-    void placeLimitOrder(double price, long quantity) {
+    void enableIngressRing(size_t capacity, size_t batchSize) {
+        ingress = std::make_unique<OrderIngress>(orderBook, capacity, batchSize);
+        ingress->start();
+    }
+
+    void stopIngress() {
+        if (ingress) {
+            ingress->stop();
+        }
+    }
+
+    size_t ingressDepth() const {
+        return ingress ? ingress->depth() : 0;
+    }
+
+    size_t ingressMaxDepth() const {
+        return ingress ? ingress->maxDepth() : 0;
+    }
+
+    // With the ingress ring enabled, these return false when the ring is full and `policy` is TRY.
+    bool placeLimitOrder(double price, long quantity, FullPolicy policy = FullPolicy::BLOCK) {
         Order order;
         order.orderId = nextOrderId++;
         order.price = price;
         order.quantity = quantity;
         order.isFilled = false;
         order.isMarketOrder = false;
-        orderBook.addOrder(order);
+        return submit(OrderCommand{OrderCommand::Kind::PLACE, order}, policy);
     }
 
-    void placeMarketOrder(long quantity) {
+    bool placeMarketOrder(long quantity, FullPolicy policy = FullPolicy::BLOCK) {
         Order order;
         order.orderId = nextOrderId++;
         order.price = 0;
         order.quantity = quantity;
         order.isFilled = false;
         order.isMarketOrder = true;
-        orderBook.addOrder(order);
+        return submit(OrderCommand{OrderCommand::Kind::PLACE, order}, policy);
     }
 
-    void cancelOrder(long orderId) {
-        orderBook.cancelOrder(orderId);
+    bool cancelOrder(long orderId, FullPolicy policy = FullPolicy::BLOCK) {
+        Order order{};
+        order.orderId = orderId;
+        return submit(OrderCommand{OrderCommand::Kind::CANCEL, order}, policy);
     }
 
     void processOrders() {
@@ -188,6 +458,19 @@ private:
     long nextOrderId;
     Cache cache;
     OrderBook orderBook;
+    std::unique_ptr<OrderIngress> ingress;
+
+    bool submit(const OrderCommand& command, FullPolicy policy) {
+        if (ingress) {
+            return ingress->submit(command, policy);
+        }
+        if (command.kind == OrderCommand::Kind::CANCEL) {
+            orderBook.cancelOrder(command.order.orderId);
+        } else {
+            orderBook.addOrder(command.order);
+        }
+        return true;
+    }
 };
 
 class MarketSimulator {
@@ -198,10 +481,10 @@ public:
         for (int i = 0; i < cycles; ++i) {
             double price = 100.0 + rand() % 100;
             long quantity = rand() % 100 + 1;
-            if (i % 2 == 0) {
-                oms.placeLimitOrder(price, quantity);
-            } else {
-                oms.placeMarketOrder(quantity);
+            bool accepted = i % 2 == 0 ? oms.placeLimitOrder(price, quantity)
+                                       : oms.placeMarketOrder(quantity, OrderManagementSystem::FullPolicy::TRY);
+            if (!accepted) {
+                std::cout << "Order rejected: ingress ring full" << std::endl;
             }
             std::this_thread::sleep_for(std::chrono::milliseconds(50));
         }
@@ -213,12 +496,15 @@ private:
 
 int main() {
     OrderManagementSystem oms(10);
+    oms.enableIngressRing(1024, 64);
     MarketSimulator simulator(oms);
 
     simulator.simulateMarketData(50);
 
     std::this_thread::sleep_for(std::chrono::seconds(2));
 
+    std::cout << "Ingress ring depth: " << oms.ingressDepth() << ", peak " << oms.ingressMaxDepth() << std::endl;
+    oms.stopIngress();
     oms.printOrderBook();
     oms.printCache();
 
@@ -0,0 +1,505 @@
+#ifndef ORDER_BOOK_H
+#define ORDER_BOOK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// A price-time order book whose price representation, level storage, fill allocation and event
+// callbacks are all template parameters, so each simulator gets a specialised book with no virtual
+// calls or string comparisons on the matching path:
+//
+//     matching::OrderBook<matching::TickPrice<100>, matching::LadderLevels> book(90.0, 2048);
+//     book.add(1, matching::Side::BUY, 100.25, 10);
+namespace matching {
+
+enum class Side : uint8_t { BUY, SELL };
+
+class LevelBitmap {
+public:
+    void resize(size_t levelCount) {
+        words.assign((levelCount + 63) / 64, 0);
+    }
+
+    void set(size_t index) {
+        words[index >> 6] |= (uint64_t(1) << (index & 63));
+    }
+
+    void clear(size_t index) {
+        words[index >> 6] &= ~(uint64_t(1) << (index & 63));
+    }
+
+    bool test(size_t index) const {
+        return (words[index >> 6] >> (index & 63)) & 1;
+    }
+
+    int highestAtOrBelow(int index) const {
+        if (index < 0) {
+            return -1;
+        }
+        int word = index >> 6;
+        uint64_t bits = words[word] & (~uint64_t(0) >> (63 - (index & 63)));
+        while (true) {
+            if (bits != 0) {
+                return (word << 6) + 63 - __builtin_clzll(bits);
+            }
+            if (--word < 0) {
+                return -1;
+            }
+            bits = words[word];
+        }
+    }
+
+    int lowestAtOrAbove(int index) const {
+        int wordCount = static_cast<int>(words.size());
+        int word = index >> 6;
+        if (word >= wordCount) {
+            return -1;
+        }
+        uint64_t bits = words[word] & (~uint64_t(0) << (index & 63));
+        while (true) {
+            if (bits != 0) {
+                return (word << 6) + __builtin_ctzll(bits);
+            }
+            if (++word >= wordCount) {
+                return -1;
+            }
+            bits = words[word];
+        }
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+// Price policies map an external price to the key levels are stored under.
+struct DoublePrice {
+    using Key = double;
+    static Key toKey(double price) { return price; }
+    static double toPrice(Key key) { return key; }
+};
+
+template <int64_t TicksPerUnit>
+struct TickPrice {
+    using Key = int64_t;
+    static Key toKey(double price) { return std::llround(price * TicksPerUnit); }
+    static double toPrice(Key key) { return static_cast<double>(key) / TicksPerUnit; }
+};
+
+// Allocation policies decide how an aggressive order's quantity is shared among the orders resting
+// at one price level. The level exposes head(), valid(), next(), quantity(), totalQuantity() and
+// fill() in time priority; fill() may retire the order it is given, so policies read next() first.
+struct FifoAllocation {
+    static constexpr bool timePriorityOnly = true;
+
+    template <typename Level, typename Quantity>
+    static Quantity allocate(Level& level, Quantity quantity) {
+        Quantity remaining = quantity;
+        for (auto order = level.head(); level.valid(order) && remaining > 0;) {
+            auto next = level.next(order);
+            Quantity fillQuantity = std::min(remaining, static_cast<Quantity>(level.quantity(order)));
+            level.fill(order, fillQuantity);
+            remaining -= fillQuantity;
+            order = next;
+        }
+        return quantity - remaining;
+    }
+};
+
+// Shares proportional to resting size, rounded down; shares below MinAllocation are dropped and
+// whatever the rounding leaves over goes out in time priority. One pass, no sorting.
+template <int MinAllocation = 1>
+struct ProRataAllocation {
+    static constexpr bool timePriorityOnly = false;
+
+    template <typename Level, typename Quantity>
+    static Quantity allocate(Level& level, Quantity quantity) {
+        auto total = level.totalQuantity();
+        if (quantity <= 0 || quantity >= total) {
+            return FifoAllocation::allocate(level, quantity);
+        }
+        Quantity allocated = 0;
+        for (auto order = level.head(); level.valid(order);) {
+            auto next = level.next(order);
+            Quantity share = proRataShare(static_cast<Quantity>(level.quantity(order)), quantity, static_cast<Quantity>(total));
+            if (share >= MinAllocation) {
+                level.fill(order, share);
+                allocated += share;
+            }
+            order = next;
+        }
+        return allocated + FifoAllocation::allocate(level, quantity - allocated);
+    }
+
+private:
+    template <typename Quantity>
+    static Quantity proRataShare(Quantity resting, Quantity incoming, Quantity total) {
+        if constexpr (std::is_integral<Quantity>::value) {
+            return static_cast<Quantity>(static_cast<int64_t>(resting) * incoming / total);
+        } else {
+            return std::floor(resting * incoming / total);
+        }
+    }
+};
+
+// The order at the front of the level is filled first, up to TopOrderCap, and the rest of the
+// aggressive quantity is allocated pro rata.
+template <int TopOrderCap, int MinAllocation = 1>
+struct TopOrderProRataAllocation {
+    static constexpr bool timePriorityOnly = false;
+
+    template <typename Level, typename Quantity>
+    static Quantity allocate(Level& level, Quantity quantity) {
+        Quantity topFill = 0;
+        auto top = level.head();
+        if (level.valid(top) && quantity > 0) {
+            topFill = std::min(std::min(quantity, static_cast<Quantity>(level.quantity(top))), static_cast<Quantity>(TopOrderCap));
+            level.fill(top, topFill);
+        }
+        return topFill + ProRataAllocation<MinAllocation>::allocate(level, quantity - topFill);
+    }
+};
+
+// Level containers hold one side of the book keyed by price, iterated best price first.
+template <typename Key, typename Level, bool IsBid>
+class MapLevels {
+public:
+    MapLevels(Key, size_t) {}
+
+    bool empty() const { return levels.empty(); }
+    Key bestKey() const { return levels.begin()->first; }
+    Level& bestLevel() { return levels.begin()->second; }
+
+    Level* find(Key key) {
+        auto it = levels.find(key);
+        return it == levels.end() ? nullptr : &it->second;
+    }
+
+    Level* obtain(Key key) {
+        return &levels[key];
+    }
+
+    void remove(Key key) {
+        levels.erase(key);
+    }
+
+    template <typename Visit>
+    void visit(size_t maxLevels, Visit visit) const {
+        size_t visited = 0;
+        for (auto it = levels.begin(); it != levels.end() && visited < maxLevels; ++it, ++visited) {
+            visit(it->first, it->second);
+        }
+    }
+
+private:
+    using Compare = typename std::conditional<IsBid, std::greater<Key>, std::less<Key>>::type;
+    std::map<Key, Level, Compare> levels;
+};
+
+// A dense array of `levelCount` levels starting at `lowKey` with a bitmap of occupied levels, for
+// integer price keys. Prices outside the ladder are rejected.
+template <typename Key, typename Level, bool IsBid>
+class LadderLevels {
+    static_assert(std::is_integral<Key>::value, "LadderLevels needs an integer price key (TickPrice)");
+
+public:
+    LadderLevels(Key lowKey, size_t levelCount) : baseKey(lowKey), levels(levelCount), best(-1) {
+        occupied.resize(levelCount);
+    }
+
+    bool empty() const { return best < 0; }
+    Key bestKey() const { return baseKey + best; }
+    Level& bestLevel() { return levels[best]; }
+
+    Level* find(Key key) {
+        int index = indexOf(key);
+        return index >= 0 && occupied.test(index) ? &levels[index] : nullptr;
+    }
+
+    Level* obtain(Key key) {
+        int index = indexOf(key);
+        if (index < 0) {
+            return nullptr;
+        }
+        occupied.set(index);
+        if (best < 0 || (IsBid ? index > best : index < best)) {
+            best = index;
+        }
+        return &levels[index];
+    }
+
+    void remove(Key key) {
+        int index = indexOf(key);
+        occupied.clear(index);
+        if (index == best) {
+            best = next(best);
+        }
+    }
+
+    template <typename Visit>
+    void visit(size_t maxLevels, Visit visit) const {
+        size_t visited = 0;
+        for (int index = best; index >= 0 && visited < maxLevels; index = next(index), ++visited) {
+            visit(baseKey + index, levels[index]);
+        }
+    }
+
+private:
+    Key baseKey;
+    std::vector<Level> levels;
+    LevelBitmap occupied;
+    int best;
+
+    int indexOf(Key key) const {
+        Key offset = key - baseKey;
+        return offset >= 0 && offset < static_cast<Key>(levels.size()) ? static_cast<int>(offset) : -1;
+    }
+
+    int next(int index) const {
+        return IsBid ? occupied.highestAtOrBelow(index - 1) : occupied.lowestAtOrAbove(index + 1);
+    }
+};
+
+struct NullListener {
+    template <typename OrderId, typename Quantity>
+    void onTrade(OrderId, OrderId, double, Quantity) {}
+
+    template <typename Quantity>
+    void onLevelChanged(Side, double, Quantity, size_t) {}
+};
+
+template <typename PricePolicy = DoublePrice,
+          template <typename, typename, bool> class LevelContainer = MapLevels,
+          typename AllocationPolicy = FifoAllocation,
+          typename Listener = NullListener,
+          typename Quantity = int64_t>
+class OrderBook {
+public:
+    using Key = typename PricePolicy::Key;
+    using OrderId = uint64_t;
+
+    // `lowPrice` and `levelCount` size a LadderLevels book; MapLevels ignores them.
+    explicit OrderBook(double lowPrice = 0, size_t levelCount = 0, Listener listener = Listener())
+        : bids(PricePolicy::toKey(lowPrice), levelCount), asks(PricePolicy::toKey(lowPrice), levelCount), events(listener) {}
+
+    // Matches against the opposite side and rests any remainder; returns false if the remainder
+    // could not rest because its price is outside a ladder book.
+    bool add(OrderId id, Side side, double price, Quantity quantity) {
+        Key key = PricePolicy::toKey(price);
+        if (side == Side::BUY) {
+            quantity = sweep(asks, Side::SELL, id, quantity, [key](Key restingKey) { return restingKey <= key; });
+            return quantity == 0 || rest(bids, id, side, key, quantity);
+        }
+        quantity = sweep(bids, Side::BUY, id, quantity, [key](Key restingKey) { return restingKey >= key; });
+        return quantity == 0 || rest(asks, id, side, key, quantity);
+    }
+
+    // Takes whatever liquidity there is and never rests; returns the unfilled quantity.
+    Quantity market(OrderId id, Side side, Quantity quantity) {
+        auto anyPrice = [](Key) { return true; };
+        return side == Side::BUY ? sweep(asks, Side::SELL, id, quantity, anyPrice)
+                                 : sweep(bids, Side::BUY, id, quantity, anyPrice);
+    }
+
+    bool cancel(OrderId id) {
+        auto it = locations.find(id);
+        if (it == locations.end()) {
+            return false;
+        }
+        Location location = it->second;
+        locations.erase(it);
+        return location.side == Side::BUY ? removeResting(bids, location, id) : removeResting(asks, location, id);
+    }
+
+    bool contains(OrderId id) const { return locations.count(id) != 0; }
+    bool hasBid() const { return !bids.empty(); }
+    bool hasAsk() const { return !asks.empty(); }
+    double bestBid() const { return PricePolicy::toPrice(bids.bestKey()); }
+    double bestAsk() const { return PricePolicy::toPrice(asks.bestKey()); }
+    size_t orderCount() const { return locations.size(); }
+
+    // Calls visit(price, totalQuantity, orderCount) for up to `maxLevels` levels, best first.
+    template <typename Visit>
+    void visitLevels(Side side, size_t maxLevels, Visit visit) const {
+        auto forward = [&visit](Key key, const Level& level) {
+            visit(PricePolicy::toPrice(key), level.totalQuantity, level.orderCount());
+        };
+        if (side == Side::BUY) {
+            bids.visit(maxLevels, forward);
+        } else {
+            asks.visit(maxLevels, forward);
+        }
+    }
+
+    Listener& listener() {
+        return events;
+    }
+
+private:
+    struct RestingOrder {
+        OrderId id;
+        Quantity quantity;
+    };
+
+    // Filled and cancelled orders stay behind as zero-quantity entries, so every resting order keeps
+    // its index and a cancel is O(1). Orders before `head` are all dead; the dead entries are
+    // reclaimed once they make up half the level.
+    struct Level {
+        std::vector<RestingOrder> orders;
+        size_t head = 0;
+        size_t liveCount = 0;
+        Quantity totalQuantity = 0;
+
+        size_t orderCount() const { return liveCount; }
+    };
+
+    struct Location {
+        Side side;
+        Key key;
+        size_t index;
+    };
+
+    // What the allocation policy sees of the passive level it is filling an aggressor against.
+    class PassiveLevel {
+    public:
+        static constexpr size_t END = static_cast<size_t>(-1);
+
+        PassiveLevel(OrderBook& book, Level& level, OrderId taker, Side passiveSide, double price)
+            : book(book), level(level), taker(taker), passiveSide(passiveSide), price(price) {}
+
+        size_t head() const {
+            size_t order = level.head;
+            return order < level.orders.size() && level.orders[order].quantity != 0 ? order : next(order);
+        }
+        bool valid(size_t order) const { return order != END; }
+        size_t next(size_t order) const {
+            while (++order < level.orders.size()) {
+                if (level.orders[order].quantity != 0) {
+                    return order;
+                }
+            }
+            return END;
+        }
+        Quantity quantity(size_t order) const { return level.orders[order].quantity; }
+        Quantity totalQuantity() const { return level.totalQuantity; }
+
+        void fill(size_t order, Quantity quantity) {
+            if (quantity <= 0) {
+                return;
+            }
+            RestingOrder& maker = level.orders[order];
+            maker.quantity -= quantity;
+            level.totalQuantity -= quantity;
+            if (passiveSide == Side::SELL) {
+                book.events.onTrade(taker, maker.id, price, quantity);
+            } else {
+                book.events.onTrade(maker.id, taker, price, quantity);
+            }
+            if (maker.quantity == 0) {
+                book.locations.erase(maker.id);
+                --level.liveCount;
+            }
+        }
+
+    private:
+        OrderBook& book;
+        Level& level;
+        OrderId taker;
+        Side passiveSide;
+        double price;
+    };
+
+    LevelContainer<Key, Level, true> bids;
+    LevelContainer<Key, Level, false> asks;
+    std::unordered_map<OrderId, Location> locations;
+    Listener events;
+
+    template <typename Levels, typename Crosses>
+    Quantity sweep(Levels& levels, Side passiveSide, OrderId taker, Quantity quantity, Crosses crosses) {
+        while (quantity > 0 && !levels.empty()) {
+            Key key = levels.bestKey();
+            if (!crosses(key)) {
+                break;
+            }
+            Level& level = levels.bestLevel();
+            double price = PricePolicy::toPrice(key);
+            PassiveLevel passive(*this, level, taker, passiveSide, price);
+            quantity -= AllocationPolicy::allocate(passive, quantity);
+            dropDead(level);
+            events.onLevelChanged(passiveSide, price, level.totalQuantity, level.orderCount());
+            if (level.orderCount() == 0) {
+                levels.remove(key);
+            }
+        }
+        return quantity;
+    }
+
+    // Moves `head` past dead entries and compacts the level once dead entries make up half of it,
+    // re-pointing the survivors' locations; the compaction cost is paid for by the removals.
+    void dropDead(Level& level) {
+        auto& orders = level.orders;
+        if (level.liveCount == 0) {
+            orders.clear();
+            level.head = 0;
+            return;
+        }
+        while (orders[level.head].quantity == 0) {
+            ++level.head;
+        }
+        size_t dead = orders.size() - level.liveCount;
+        if (dead < 32 || dead * 2 < orders.size()) {
+            return;
+        }
+        orders.erase(std::remove_if(orders.begin(), orders.end(), [](const RestingOrder& order) { return order.quantity == 0; }),
+                     orders.end());
+        level.head = 0;
+        for (size_t index = 0; index < orders.size(); ++index) {
+            locations[orders[index].id].index = index;
+        }
+    }
+
+    template <typename Levels>
+    bool rest(Levels& levels, OrderId id, Side side, Key key, Quantity quantity) {
+        Level* level = levels.obtain(key);
+        if (!level) {
+            return false;
+        }
+        locations[id] = {side, key, level->orders.size()};
+        level->orders.push_back({id, quantity});
+        ++level->liveCount;
+        level->totalQuantity += quantity;
+        events.onLevelChanged(side, PricePolicy::toPrice(key), level->totalQuantity, level->orderCount());
+        return true;
+    }
+
+    template <typename Levels>
+    bool removeResting(Levels& levels, const Location& location, OrderId id) {
+        Level* level = levels.find(location.key);
+        if (!level) {
+            return false;
+        }
+        RestingOrder& order = level->orders[location.index];
+        if (order.id != id || order.quantity == 0) {
+            return false;
+        }
+        level->totalQuantity -= order.quantity;
+        order.quantity = 0;
+        --level->liveCount;
+        dropDead(*level);
+        events.onLevelChanged(location.side, PricePolicy::toPrice(location.key), level->totalQuantity, level->orderCount());
+        if (level->orderCount() == 0) {
+            levels.remove(location.key);
+        }
+        return true;
+    }
+};
+
+}  // namespace matching
+
+#endif
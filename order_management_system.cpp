@@ -1,5 +1,7 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <limits>
 #include <ctime>
 #include <cstdlib>
 
@@ -14,31 +16,77 @@ struct Order {
 
 enum OrderType {LIMIT, MARKET};
 
+// One report per incoming order, however many resting orders it traded against.
+struct ExecutionReport {
+    long orderId;
+    long requestedQuantity;
+    long filledQuantity;
+    long leftoverQuantity;
+    double notional;
+    int levelsTouched;
+    int ordersTouched;
+
+    double vwap() const {
+        return filledQuantity > 0 ? notional / filledQuantity : 0.0;
+    }
+};
+
 class OrderBook {
 public:
-    void addOrder(Order order) {
+    OrderBook() : head(0), liveOrders(0), deadSlots(0) {}
+
+    // Resting limit orders are offers kept in price-time priority; market and marketable-limit
+    // orders are takers that sweep them and never rest.
+    ExecutionReport addOrder(Order order) {
         if (order.isMarketOrder) {
-            executeMarketOrder(order);
-        } else {
-            orderBook.push_back(order);
+            return executeMarketOrder(order);
         }
+        auto position = std::upper_bound(orderBook.begin() + head, orderBook.end(), order.price,
+            [](double price, const Order& resting) { return price < resting.price; });
+        orderBook.insert(position, order);
+        ++liveOrders;
+        return ExecutionReport{order.orderId, order.quantity, 0, order.quantity, 0.0, 0, 0};
+    }
+
+    ExecutionReport executeMarketableLimitOrder(Order order) {
+        return sweep(order, order.price);
     }
 
     void cancelOrder(long orderId) {
-        for (auto& order : orderBook) {
-            if (order.orderId == orderId && !order.isFilled && !order.isCancelled) {
+        for (size_t i = head; i < orderBook.size(); ++i) {
+            Order& order = orderBook[i];
+            if (order.orderId == orderId && isLive(order)) {
                 order.isCancelled = true;
+                retire();
                 break;
             }
         }
+        compactIfSparse();
     }
 
     void executeOrders() {
-        for (auto& order : orderBook) {
-            if (!order.isFilled && !order.isCancelled) {
-                matchOrder(order);
-            }
+        while (head < orderBook.size() && !isLive(orderBook[head])) {
+            ++head;
         }
+        compactIfSparse();
+    }
+
+    // Drops every filled and cancelled slot in one stable pass, so time priority is unchanged.
+    void compact() {
+        orderBook.erase(std::remove_if(orderBook.begin(), orderBook.end(),
+                                       [](const Order& order) { return !isLive(order); }),
+                        orderBook.end());
+        head = 0;
+        deadSlots = 0;
+    }
+
+    size_t liveOrderCount() const {
+        return liveOrders;
+    }
+
+    double deadSlotRatio() const {
+        size_t slots = liveOrders + deadSlots;
+        return slots == 0 ? 0.0 : static_cast<double>(deadSlots) / slots;
     }
 
     void printOrderBook() {
@@ -51,39 +99,69 @@ public:
 
 private:
     std::vector<Order> orderBook;
+    size_t head;  // Everything before this index is filled or cancelled.
+    size_t liveOrders;
+    size_t deadSlots;
 
-    void matchOrder(Order& incomingOrder) {
-        if (incomingOrder.isMarketOrder) {
-            executeMarketOrder(incomingOrder);
-        } else {
-            for (auto& limitOrder : orderBook) {
-                if (!limitOrder.isFilled && !limitOrder.isCancelled && limitOrder.price <= incomingOrder.price) {
-                    executeTrade(incomingOrder, limitOrder);
-                    incomingOrder.isFilled = true;
-                    limitOrder.isFilled = true;
-                    break;
-                }
-            }
+    static constexpr size_t MIN_COMPACTION_SLOTS = 64;
+
+    void retire() {
+        --liveOrders;
+        ++deadSlots;
+    }
+
+    // Compacts once there are at least MIN_COMPACTION_SLOTS dead slots and they outnumber the live
+    // ones (deadSlotRatio() above 0.5). That keeps the amortised cost per retired order constant
+    // while bounding every scan to about twice the live book.
+    void compactIfSparse() {
+        if (deadSlots >= MIN_COMPACTION_SLOTS && deadSlots > liveOrders) {
+            compact();
         }
     }
 
-    void executeMarketOrder(Order& marketOrder) {
-        for (auto& limitOrder : orderBook) {
-            if (!limitOrder.isFilled && !limitOrder.isCancelled) {
-                executeTrade(marketOrder, limitOrder);
-                marketOrder.isFilled = true;
-                limitOrder.isFilled = true;
+    static bool isLive(const Order& order) {
+        return !order.isFilled && !order.isCancelled;
+    }
+
+    ExecutionReport executeMarketOrder(Order& marketOrder) {
+        return sweep(marketOrder, std::numeric_limits<double>::infinity());
+    }
+
+    // Walks the book from the best price until the taker is filled, the next price is beyond
+    // `limitPrice`, or the book is exhausted, folding every fill into the running totals.
+    ExecutionReport sweep(Order& taker, double limitPrice) {
+        ExecutionReport report{taker.orderId, taker.quantity, 0, 0, 0.0, 0, 0};
+        double lastPrice = 0.0;
+
+        for (size_t i = head; i < orderBook.size() && taker.quantity > 0; ++i) {
+            Order& resting = orderBook[i];
+            if (!isLive(resting)) {
+                continue;
+            }
+            if (resting.price > limitPrice) {
                 break;
             }
-        }
-    }
+            long tradedQuantity = std::min(taker.quantity, resting.quantity);
+            taker.quantity -= tradedQuantity;
+            resting.quantity -= tradedQuantity;
+            if (resting.quantity == 0) {
+                resting.isFilled = true;
+                retire();
+            }
 
-    void executeTrade(Order& buyOrder, Order& sellOrder) {
-        double tradePrice = sellOrder.price;
-        long tradedQuantity = std::min(buyOrder.quantity, sellOrder.quantity);
+            if (report.ordersTouched == 0 || resting.price != lastPrice) {
+                ++report.levelsTouched;
+                lastPrice = resting.price;
+            }
+            ++report.ordersTouched;
+            report.filledQuantity += tradedQuantity;
+            report.notional += tradedQuantity * resting.price;
+        }
 
-        buyOrder.quantity -= tradedQuantity;
-        sellOrder.quantity -= tradedQuantity;
+        taker.isFilled = taker.quantity == 0;
+        report.leftoverQuantity = taker.quantity;
+        executeOrders();
+        return report;
     }
 };
 
@@ -102,7 +180,7 @@ public:
         orderBook.addOrder(order);
     }
 
-    void placeMarketOrder(long quantity) {
+    ExecutionReport placeMarketOrder(long quantity) {
         Order order;
         order.orderId = nextOrderId++;
         order.price = 0;
@@ -110,7 +188,19 @@ public:
         order.isFilled = false;
         order.isCancelled = false;
         order.isMarketOrder = true;
-        orderBook.addOrder(order);
+        return orderBook.addOrder(order);
+    }
+
+    // Takes liquidity up to `price`; whatever cannot be filled there is reported, not rested.
+    ExecutionReport placeMarketableLimitOrder(double price, long quantity) {
+        Order order;
+        order.orderId = nextOrderId++;
+        order.price = price;
+        order.quantity = quantity;
+        order.isFilled = false;
+        order.isCancelled = false;
+        order.isMarketOrder = false;
+        return orderBook.executeMarketableLimitOrder(order);
     }
 
     void cancelOrder(long orderId) {
@@ -125,11 +215,30 @@ public:
         orderBook.printOrderBook();
     }
 
+    void compactOrderBook() {
+        orderBook.compact();
+    }
+
+    size_t liveOrderCount() const {
+        return orderBook.liveOrderCount();
+    }
+
+    double deadSlotRatio() const {
+        return orderBook.deadSlotRatio();
+    }
+
 private:
     long nextOrderId;
     OrderBook orderBook;
 };
 
+void printExecutionReport(const ExecutionReport& report) {
+    std::cout << "Execution Report for Order " << report.orderId << ": Filled " << report.filledQuantity
+              << " of " << report.requestedQuantity << " at VWAP " << report.vwap()
+              << " across " << report.levelsTouched << " levels (" << report.ordersTouched
+              << " orders), Leftover: " << report.leftoverQuantity << std::endl;
+}
+
 int main() {
     srand(static_cast<unsigned int>(time(0)));
 
@@ -137,9 +246,12 @@ int main() {
 
     oms.placeLimitOrder(100.50, 50);
     oms.placeLimitOrder(99.75, 30);
-    oms.placeMarketOrder(100);
+    printExecutionReport(oms.placeMarketOrder(100));
     oms.placeLimitOrder(101.25, 20);
-    oms.placeMarketOrder(50);
+    oms.placeLimitOrder(100.75, 40);
+    oms.placeLimitOrder(101.50, 60);
+    printExecutionReport(oms.placeMarketableLimitOrder(101.25, 50));
+    printExecutionReport(oms.placeMarketOrder(50));
 
     std::cout << "Order Book Before Processing:" << std::endl;
     oms.printOrderBook();
@@ -7,6 +7,7 @@
 #include <atomic>
 #include <chrono>
 #include <algorithm>
+#include <cstdint>
 
 struct Order {
     long orderId;
@@ -14,21 +15,47 @@ struct Order {
     long quantity;
     bool isMarketOrder;
     bool isFilled;
+    int64_t submittedAtNs;
+    bool matchRecorded;
 };
 
+inline int64_t monotonicNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Tells the core this is a spin-wait loop: the thread backs off without giving up its time slice.
+inline void cpuRelax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
 class OrderBook {
 public:
-    OrderBook() : orderIdCounter(1) {}
+    OrderBook() : orderIdCounter(1), submittedCount(0), processorParked(false) {}
 
     void addOrder(Order order) {
-        std::lock_guard<std::mutex> lock(orderBookMutex);
-        if (order.isMarketOrder) {
-            marketOrders.push(order);
-        } else {
-            limitOrders.push_back(order);
-            std::sort(limitOrders.begin(), limitOrders.end(), [](const Order& a, const Order& b) {
-                return a.price < b.price;
-            });
+        {
+            std::lock_guard<std::mutex> lock(orderBookMutex);
+            order.submittedAtNs = monotonicNanos();
+            order.matchRecorded = false;
+            if (order.isMarketOrder) {
+                marketOrders.push(order);
+            } else {
+                // Kept sorted by descending price so the best offer sits at the back; equal prices
+                // insert ahead of older orders to preserve time priority.
+                auto position = std::lower_bound(limitOrders.begin(), limitOrders.end(), order.price,
+                    [](const Order& resting, double price) { return resting.price > price; });
+                limitOrders.insert(position, order);
+            }
+        }
+        submittedCount.fetch_add(1);
+        if (processorParked.load()) {
+            std::lock_guard<std::mutex> lock(signalMutex);
+            workReady.notify_one();
         }
     }
 
@@ -45,23 +72,71 @@ public:
     void processOrders() {
         std::lock_guard<std::mutex> lock(orderBookMutex);
         while (!marketOrders.empty() && !limitOrders.empty()) {
-            Order marketOrder = marketOrders.front();
-            Order limitOrder = limitOrders.front();
+            Order& marketOrder = marketOrders.front();
+            Order& limitOrder = limitOrders.back();
+
+            if (limitOrder.isFilled) {
+                limitOrders.pop_back();
+                continue;
+            }
 
-            if (marketOrder.price >= limitOrder.price) {
+            if (marketOrder.isMarketOrder || marketOrder.price >= limitOrder.price) {
+                // Latency runs to the first fill; time a partly filled order then waits for more
+                // liquidity is not matching latency.
+                if (!marketOrder.matchRecorded) {
+                    matchLatenciesNs.push_back(monotonicNanos() - marketOrder.submittedAtNs);
+                    marketOrder.matchRecorded = true;
+                }
                 executeTrade(marketOrder, limitOrder);
-                marketOrders.pop();
-                limitOrders.erase(limitOrders.begin());
+                if (limitOrder.quantity == 0) {
+                    limitOrders.pop_back();
+                }
+                if (marketOrder.quantity == 0) {
+                    marketOrders.pop();
+                }
             } else {
                 break;
             }
         }
     }
 
+    uint64_t submitted() const {
+        return submittedCount.load();
+    }
+
+    // Parks the caller until more than `seen` orders have been submitted or `stopFlag` is raised.
+    void waitForWork(uint64_t seen, const std::atomic<bool>& stopFlag) {
+        std::unique_lock<std::mutex> lock(signalMutex);
+        processorParked.store(true);
+        workReady.wait(lock, [&] { return submitted() != seen || stopFlag.load(); });
+        processorParked.store(false);
+    }
+
+    void wakeProcessor() {
+        std::lock_guard<std::mutex> lock(signalMutex);
+        workReady.notify_all();
+    }
+
+    void printLatencyReport() {
+        std::lock_guard<std::mutex> lock(orderBookMutex);
+        if (matchLatenciesNs.empty()) {
+            std::cout << "No matches recorded" << std::endl;
+            return;
+        }
+        std::vector<int64_t> sorted = matchLatenciesNs;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) {
+            return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+        };
+        std::cout << "Insert-to-match latency over " << sorted.size() << " orders: p50 "
+                  << percentile(0.50) / 1000.0 << " us, p99 " << percentile(0.99) / 1000.0 << " us" << std::endl;
+    }
+
     void printOrderBook() {
         std::lock_guard<std::mutex> lock(orderBookMutex);
         std::cout << "Limit Orders:" << std::endl;
-        for (auto& order : limitOrders) {
+        for (auto it = limitOrders.rbegin(); it != limitOrders.rend(); ++it) {
+            const Order& order = *it;
             std::cout << "ID: " << order.orderId << ", Price: " << order.price
                       << ", Quantity: " << order.quantity << ", Filled: " << order.isFilled << std::endl;
         }
@@ -72,6 +147,12 @@ private:
     std::queue<Order> marketOrders;
     std::mutex orderBookMutex;
     long orderIdCounter;
+    std::vector<int64_t> matchLatenciesNs;
+
+    std::atomic<uint64_t> submittedCount;
+    std::atomic<bool> processorParked;
+    std::mutex signalMutex;
+    std::condition_variable workReady;
 
     void executeTrade(Order& marketOrder, Order& limitOrder) {
         long tradedQuantity = std::min(marketOrder.quantity, limitOrder.quantity);
@@ -98,7 +179,7 @@ public:
     void placeMarketOrder(long quantity) {
         Order order;
         order.orderId = nextOrderId++;
-        order.price = 0;  
+        order.price = 0;
         order.quantity = quantity;
         order.isFilled = false;
         order.isMarketOrder = true;
@@ -117,6 +198,14 @@ public:
         orderBook.printOrderBook();
     }
 
+    void printLatencyReport() {
+        orderBook.printLatencyReport();
+    }
+
+    OrderBook& book() {
+        return orderBook;
+    }
+
 private:
     long nextOrderId;
     OrderBook orderBook;
@@ -124,14 +213,18 @@ private:
 
 class OrderProcessor {
 public:
-    OrderProcessor(OrderManagementSystem& oms) : oms(oms), stopFlag(false) {}
+    enum class Mode { POLLING, EVENT_DRIVEN };
+
+    OrderProcessor(OrderManagementSystem& oms, Mode mode = Mode::POLLING) : oms(oms), mode(mode), stopFlag(false) {}
 
     void startProcessing() {
-        processingThread = std::thread(&OrderProcessor::processOrders, this);
+        processingThread = std::thread(mode == Mode::POLLING ? &OrderProcessor::processOrders
+                                                             : &OrderProcessor::processOnEvents, this);
     }
 
     void stopProcessing() {
         stopFlag = true;
+        oms.book().wakeProcessor();
         if (processingThread.joinable()) {
             processingThread.join();
         }
@@ -139,13 +232,44 @@ public:
 
     void processOrders() {
         while (!stopFlag) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100)); 
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            oms.processOrders();
+        }
+    }
+
+    void processOnEvents() {
+        const int minSpin = 64;
+        const int maxSpin = 16384;
+        int spinBudget = 1024;
+        uint64_t seen = 0;
+        OrderBook& book = oms.book();
+
+        while (!stopFlag) {
+            bool foundWhileSpinning = false;
+            for (int i = 0; i < spinBudget; ++i) {
+                if (book.submitted() != seen) {
+                    foundWhileSpinning = true;
+                    break;
+                }
+                cpuRelax();
+            }
+
+            // Grow the spin window while work keeps arriving inside it, shrink it after each park.
+            if (foundWhileSpinning) {
+                spinBudget = std::min(spinBudget * 2, maxSpin);
+            } else {
+                spinBudget = std::max(spinBudget / 2, minSpin);
+                book.waitForWork(seen, stopFlag);
+            }
+
+            seen = book.submitted();
             oms.processOrders();
         }
     }
 
 private:
     OrderManagementSystem& oms;
+    Mode mode;
     std::thread processingThread;
     std::atomic<bool> stopFlag;
 };
@@ -156,14 +280,14 @@ public:
 
     void simulateMarketData(int cycles) {
         for (int i = 0; i < cycles; ++i) {
-            double price = 100.0 + rand() % 100;  
-            long quantity = rand() % 100 + 1;  
+            double price = 100.0 + rand() % 100;
+            long quantity = rand() % 100 + 1;
             if (i % 2 == 0) {
                 oms.placeLimitOrder(price, quantity);
             } else {
                 oms.placeMarketOrder(quantity);
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));  
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
         }
     }
 
@@ -173,7 +297,7 @@ private:
 
 int main() {
     OrderManagementSystem oms;
-    OrderProcessor processor(oms);
+    OrderProcessor processor(oms, OrderProcessor::Mode::EVENT_DRIVEN);
     MarketSimulator simulator(oms);
 
     processor.startProcessing();
@@ -183,6 +307,7 @@ int main() {
     std::this_thread::sleep_for(std::chrono::seconds(2));
 
     oms.printOrderBook();
+    oms.printLatencyReport();
 
     processor.stopProcessing();
 
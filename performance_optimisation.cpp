@@ -4,6 +4,9 @@
 #include <algorithm>
 #include <ctime>
 #include <cstdlib>
+#include <map>
+#include <deque>
+#include <unordered_map>
 
 struct MarketData {
     double price;
@@ -13,6 +16,10 @@ struct MarketData {
     long volume;
 };
 
+enum OrderType {LIMIT, MARKET, STOP, STOP_LIMIT};
+
+enum TimeInForce {GTC, IOC, FOK};
+
 struct Order {
     long orderId;
     double price;
@@ -20,74 +27,316 @@ struct Order {
     bool isFilled;
     bool isCancelled;
     bool isMarketOrder;
+    bool isBuy;
+    OrderType type;
+    TimeInForce timeInForce;
+    double stopPrice;
+    long displaySize;
+    long hiddenQuantity;
 };
 
-enum OrderType {LIMIT, MARKET};
-
 class OrderBook {
 public:
+    OrderBook() : liveOrders(0), deadSlots(0) {}
+
     void addOrder(Order order) {
+        if (order.type == STOP || order.type == STOP_LIMIT) {
+            if (order.isBuy) {
+                buyStops.emplace(order.stopPrice, order);
+            } else {
+                sellStops.emplace(order.stopPrice, order);
+            }
+            orderIndex[order.orderId] = order;
+            return;
+        }
         if (order.isMarketOrder) {
             executeMarketOrder(order);
         } else {
-            limitOrderBook.push_back(order);
+            matchOrder(order);
         }
+        fireTriggeredStops();
     }
 
     void cancelOrder(long orderId) {
-        for (auto& order : limitOrderBook) {
-            if (order.orderId == orderId && !order.isFilled && !order.isCancelled) {
-                order.isCancelled = true;
-                break;
+        auto it = orderIndex.find(orderId);
+        if (it == orderIndex.end()) {
+            return;
+        }
+        const Order& located = it->second;
+        if (located.type == STOP || located.type == STOP_LIMIT) {
+            auto& stops = located.isBuy ? buyStops : sellStops;
+            auto range = stops.equal_range(located.stopPrice);
+            for (auto stop = range.first; stop != range.second; ++stop) {
+                if (stop->second.orderId == orderId) {
+                    stops.erase(stop);
+                    break;
+                }
+            }
+        } else {
+            std::deque<Order>* level = findLevel(located.isBuy, located.price);
+            if (level) {
+                for (auto& order : *level) {
+                    if (order.orderId == orderId && !order.isFilled && !order.isCancelled) {
+                        order.isCancelled = true;
+                        --liveOrders;
+                        ++deadSlots;
+                        break;
+                    }
+                }
             }
         }
+        orderIndex.erase(it);
+        compactIfSparse();
     }
 
     void executeOrders() {
-        while (!limitOrderBook.empty() && !marketOrderQueue.empty()) {
-            Order& marketOrder = marketOrderQueue.front();
-            Order& limitOrder = limitOrderBook.front();
-            
-            if (marketOrder.price >= limitOrder.price) {
-                executeTrade(marketOrder, limitOrder);
-                marketOrder.isFilled = true;
-                limitOrder.isFilled = true;
-                limitOrderBook.erase(limitOrderBook.begin());
-                marketOrderQueue.pop();
-            } else {
-                break;
-            }
-        }
+        fireTriggeredStops();
+        compactIfSparse();
+    }
+
+    // Cancelled orders are only flagged in place; this removes them from every level in one stable
+    // pass (time priority is unchanged) and drops levels left empty.
+    void compact() {
+        compactSide(bids);
+        compactSide(asks);
+        deadSlots = 0;
+    }
+
+    size_t liveOrderCount() const {
+        return liveOrders;
+    }
+
+    double deadSlotRatio() const {
+        size_t slots = liveOrders + deadSlots;
+        return slots == 0 ? 0.0 : static_cast<double>(deadSlots) / slots;
     }
 
     void printOrderBook() {
-        for (auto& order : limitOrderBook) {
-            std::cout << "Order ID: " << order.orderId << ", Price: " << order.price
-                      << ", Quantity: " << order.quantity << ", Filled: " << order.isFilled
-                      << ", Cancelled: " << order.isCancelled << std::endl;
+        for (auto& [price, level] : bids) {
+            printLevel(level);
+        }
+        for (auto& [price, level] : asks) {
+            printLevel(level);
+        }
+        for (auto& [stopPrice, order] : buyStops) {
+            printStop(order);
+        }
+        for (auto& [stopPrice, order] : sellStops) {
+            printStop(order);
         }
     }
 
 private:
-    std::vector<Order> limitOrderBook;
-    std::queue<Order> marketOrderQueue;
+    std::map<double, std::deque<Order>, std::greater<double>> bids;
+    std::map<double, std::deque<Order>> asks;
+    std::multimap<double, Order> buyStops;
+    std::multimap<double, Order> sellStops;
+    std::unordered_map<long, Order> orderIndex;
+    std::vector<double> pendingTradePrices;
+    size_t liveOrders;
+    size_t deadSlots;
+
+    static constexpr size_t MIN_COMPACTION_SLOTS = 64;
+
+    // Runs compact() once cancelled orders outnumber live ones, so deadSlotRatio() is above 0.5, and
+    // there are at least MIN_COMPACTION_SLOTS of them.
+    void compactIfSparse() {
+        if (deadSlots >= MIN_COMPACTION_SLOTS && deadSlots > liveOrders) {
+            compact();
+        }
+    }
+
+    template <typename Levels>
+    void compactSide(Levels& levels) {
+        for (auto levelIt = levels.begin(); levelIt != levels.end();) {
+            std::deque<Order>& level = levelIt->second;
+            level.erase(std::remove_if(level.begin(), level.end(),
+                                       [](const Order& order) { return order.isCancelled; }),
+                        level.end());
+            levelIt = level.empty() ? levels.erase(levelIt) : std::next(levelIt);
+        }
+    }
 
     void executeMarketOrder(Order& marketOrder) {
-        for (auto& limitOrder : limitOrderBook) {
-            if (!limitOrder.isFilled && !limitOrder.isCancelled) {
-                executeTrade(marketOrder, limitOrder);
-                marketOrder.isFilled = true;
-                limitOrder.isFilled = true;
+        matchOrder(marketOrder);
+    }
+
+    void matchOrder(Order& incomingOrder) {
+        if (incomingOrder.timeInForce == FOK && !canFillCompletely(incomingOrder)) {
+            incomingOrder.isCancelled = true;
+            std::cout << "Order " << incomingOrder.orderId << " killed: " << incomingOrder.quantity + incomingOrder.hiddenQuantity
+                      << " units not available" << std::endl;
+            return;
+        }
+
+        if (incomingOrder.isBuy) {
+            sweep(asks, incomingOrder);
+        } else {
+            sweep(bids, incomingOrder);
+        }
+
+        long remaining = incomingOrder.quantity + incomingOrder.hiddenQuantity;
+        if (remaining == 0) {
+            incomingOrder.isFilled = true;
+        } else if (incomingOrder.isMarketOrder || incomingOrder.timeInForce != GTC) {
+            incomingOrder.isCancelled = true;
+        } else {
+            rest(incomingOrder);
+        }
+    }
+
+    template <typename Levels>
+    void sweep(Levels& levels, Order& incomingOrder) {
+        while (incomingOrder.quantity > 0 && !levels.empty()) {
+            auto levelIt = levels.begin();
+            if (!incomingOrder.isMarketOrder && !crosses(incomingOrder, levelIt->first)) {
                 break;
             }
+
+            std::deque<Order>& level = levelIt->second;
+            Order& restingOrder = level.front();
+            if (restingOrder.isCancelled) {
+                level.pop_front();
+                --deadSlots;
+            } else {
+                executeTrade(incomingOrder, restingOrder);
+                if (incomingOrder.quantity == 0 && incomingOrder.hiddenQuantity > 0) {
+                    refreshIceberg(incomingOrder);
+                }
+                if (restingOrder.quantity == 0) {
+                    retireOrRefresh(level);
+                }
+            }
+            if (level.empty()) {
+                levels.erase(levelIt);
+            }
         }
     }
 
-    void executeTrade(Order& buyOrder, Order& sellOrder) {
-        double tradePrice = sellOrder.price;
-        long tradedQuantity = std::min(buyOrder.quantity, sellOrder.quantity);
-        buyOrder.quantity -= tradedQuantity;
-        sellOrder.quantity -= tradedQuantity;
+    bool crosses(const Order& incomingOrder, double restingPrice) const {
+        return incomingOrder.isBuy ? restingPrice <= incomingOrder.price : restingPrice >= incomingOrder.price;
+    }
+
+    template <typename Levels>
+    long availableQuantity(const Levels& levels, const Order& incomingOrder, long needed) const {
+        long available = 0;
+        for (auto levelIt = levels.begin(); levelIt != levels.end() && available < needed; ++levelIt) {
+            if (!incomingOrder.isMarketOrder && !crosses(incomingOrder, levelIt->first)) {
+                break;
+            }
+            for (const Order& order : levelIt->second) {
+                if (!order.isCancelled) {
+                    available += order.quantity + order.hiddenQuantity;
+                }
+            }
+        }
+        return available;
+    }
+
+    bool canFillCompletely(const Order& incomingOrder) const {
+        long needed = incomingOrder.quantity + incomingOrder.hiddenQuantity;
+        long available = incomingOrder.isBuy ? availableQuantity(asks, incomingOrder, needed)
+                                             : availableQuantity(bids, incomingOrder, needed);
+        return available >= needed;
+    }
+
+    void refreshIceberg(Order& order) {
+        long refill = std::min(order.displaySize, order.hiddenQuantity);
+        order.quantity = refill;
+        order.hiddenQuantity -= refill;
+    }
+
+    // A drained iceberg tranche goes to the back of its level with a fresh display quantity.
+    void retireOrRefresh(std::deque<Order>& level) {
+        Order order = level.front();
+        level.pop_front();
+        if (order.hiddenQuantity > 0) {
+            refreshIceberg(order);
+            level.push_back(order);
+        } else {
+            order.isFilled = true;
+            orderIndex.erase(order.orderId);
+            --liveOrders;
+        }
+    }
+
+    void rest(const Order& order) {
+        Order resting = order;
+        if (resting.displaySize > 0 && resting.quantity > resting.displaySize) {
+            resting.hiddenQuantity += resting.quantity - resting.displaySize;
+            resting.quantity = resting.displaySize;
+        }
+        if (resting.isBuy) {
+            bids[resting.price].push_back(resting);
+        } else {
+            asks[resting.price].push_back(resting);
+        }
+        orderIndex[resting.orderId] = resting;
+        ++liveOrders;
+    }
+
+    std::deque<Order>* findLevel(bool isBuy, double price) {
+        if (isBuy) {
+            auto it = bids.find(price);
+            return it == bids.end() ? nullptr : &it->second;
+        }
+        auto it = asks.find(price);
+        return it == asks.end() ? nullptr : &it->second;
+    }
+
+    // Buy stops fire once the market trades at or above their stop price, sell stops at or below.
+    // Each trade price only visits the stops it crosses.
+    void fireTriggeredStops() {
+        std::vector<Order> triggered;
+        while (!pendingTradePrices.empty()) {
+            double tradePrice = pendingTradePrices.back();
+            pendingTradePrices.pop_back();
+
+            auto buyEnd = buyStops.upper_bound(tradePrice);
+            for (auto it = buyStops.begin(); it != buyEnd; ++it) {
+                triggered.push_back(it->second);
+            }
+            buyStops.erase(buyStops.begin(), buyEnd);
+
+            auto sellBegin = sellStops.lower_bound(tradePrice);
+            for (auto it = sellBegin; it != sellStops.end(); ++it) {
+                triggered.push_back(it->second);
+            }
+            sellStops.erase(sellBegin, sellStops.end());
+
+            for (Order& order : triggered) {
+                orderIndex.erase(order.orderId);
+                std::cout << "Stop order " << order.orderId << " triggered at " << tradePrice << std::endl;
+                order.isMarketOrder = order.type == STOP;
+                order.type = order.type == STOP ? MARKET : LIMIT;
+                matchOrder(order);
+            }
+            triggered.clear();
+        }
+    }
+
+    void printLevel(const std::deque<Order>& level) {
+        for (const auto& order : level) {
+            std::cout << "Order ID: " << order.orderId << ", Side: " << (order.isBuy ? "BUY" : "SELL")
+                      << ", Price: " << order.price << ", Quantity: " << order.quantity
+                      << ", Hidden: " << order.hiddenQuantity << ", Filled: " << order.isFilled
+                      << ", Cancelled: " << order.isCancelled << std::endl;
+        }
+    }
+
+    void printStop(const Order& order) {
+        std::cout << "Stop Order ID: " << order.orderId << ", Side: " << (order.isBuy ? "BUY" : "SELL")
+                  << ", Stop: " << order.stopPrice << ", Quantity: " << order.quantity << std::endl;
+    }
+
+    void executeTrade(Order& incomingOrder, Order& restingOrder) {
+        double tradePrice = restingOrder.price;
+        long tradedQuantity = std::min(incomingOrder.quantity, restingOrder.quantity);
+
+        incomingOrder.quantity -= tradedQuantity;
+        restingOrder.quantity -= tradedQuantity;
+        pendingTradePrices.push_back(tradePrice);
+        std::cout << "Trade Executed: " << tradedQuantity << " units at price " << tradePrice << std::endl;
     }
 };
 
@@ -95,28 +344,47 @@ class OrderManagementSystem {
 public:
     OrderManagementSystem() : nextOrderId(1) {}
 
-    void placeLimitOrder(double price, long quantity) {
-        Order order;
-        order.orderId = nextOrderId++;
+    void placeLimitOrder(double price, long quantity, bool isBuy = false, TimeInForce timeInForce = GTC) {
+        Order order = newOrder(LIMIT, isBuy, quantity);
         order.price = price;
-        order.quantity = quantity;
-        order.isFilled = false;
-        order.isCancelled = false;
-        order.isMarketOrder = false;
+        order.timeInForce = timeInForce;
         orderBook.addOrder(order);
     }
 
-    void placeMarketOrder(long quantity) {
-        Order order;
-        order.orderId = nextOrderId++;
-        order.price = 0;
-        order.quantity = quantity;
-        order.isFilled = false;
-        order.isCancelled = false;
+    void placeMarketOrder(long quantity, bool isBuy = true) {
+        Order order = newOrder(MARKET, isBuy, quantity);
         order.isMarketOrder = true;
         orderBook.addOrder(order);
     }
 
+    void placeIocOrder(double price, long quantity, bool isBuy) {
+        placeLimitOrder(price, quantity, isBuy, IOC);
+    }
+
+    void placeFokOrder(double price, long quantity, bool isBuy) {
+        placeLimitOrder(price, quantity, isBuy, FOK);
+    }
+
+    void placeIcebergOrder(double price, long quantity, long displaySize, bool isBuy) {
+        Order order = newOrder(LIMIT, isBuy, quantity);
+        order.price = price;
+        order.displaySize = displaySize;
+        orderBook.addOrder(order);
+    }
+
+    void placeStopOrder(double stopPrice, long quantity, bool isBuy) {
+        Order order = newOrder(STOP, isBuy, quantity);
+        order.stopPrice = stopPrice;
+        orderBook.addOrder(order);
+    }
+
+    void placeStopLimitOrder(double stopPrice, double limitPrice, long quantity, bool isBuy) {
+        Order order = newOrder(STOP_LIMIT, isBuy, quantity);
+        order.stopPrice = stopPrice;
+        order.price = limitPrice;
+        orderBook.addOrder(order);
+    }
+
     void cancelOrder(long orderId) {
         orderBook.cancelOrder(orderId);
     }
@@ -129,9 +397,38 @@ public:
         orderBook.printOrderBook();
     }
 
+    void compactOrderBook() {
+        orderBook.compact();
+    }
+
+    size_t liveOrderCount() const {
+        return orderBook.liveOrderCount();
+    }
+
+    double deadSlotRatio() const {
+        return orderBook.deadSlotRatio();
+    }
+
 private:
     long nextOrderId;
     OrderBook orderBook;
+
+    Order newOrder(OrderType type, bool isBuy, long quantity) {
+        Order order;
+        order.orderId = nextOrderId++;
+        order.price = 0;
+        order.quantity = quantity;
+        order.isFilled = false;
+        order.isCancelled = false;
+        order.isMarketOrder = false;
+        order.isBuy = isBuy;
+        order.type = type;
+        order.timeInForce = GTC;
+        order.stopPrice = 0;
+        order.displaySize = 0;
+        order.hiddenQuantity = 0;
+        return order;
+    }
 };
 
 class MarketSimulator {
@@ -197,5 +494,19 @@ int main() {
     std::cout << "Order Book After Canceling Order 3:" << std::endl;
     oms.printOrderBook();
 
+    OrderManagementSystem advanced;
+    advanced.placeIcebergOrder(101.00, 300, 100, false);
+    advanced.placeLimitOrder(101.00, 50, false);
+    advanced.placeLimitOrder(102.00, 80, false);
+    advanced.placeStopOrder(101.50, 40, true);
+    advanced.placeStopLimitOrder(100.50, 100.00, 20, false);
+    advanced.placeFokOrder(101.00, 1000, true);
+    advanced.placeIocOrder(101.00, 150, true);
+    advanced.placeLimitOrder(102.00, 200, true);
+    advanced.placeMarketOrder(10, true);
+
+    std::cout << "Order Book After Advanced Orders:" << std::endl;
+    advanced.printOrderBook();
+
     return 0;
 }